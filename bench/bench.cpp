@@ -0,0 +1,866 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * OutputInfo benchmarks
+ * =============================================================================
+ *
+ * Standalone benchmark of the extension's hot paths. src/extension.cpp is
+ * compiled as is against the mock SDK in mock/, the natives are called
+ * directly with a mock plugin context on synthetic entities whose datamaps
+ * have deep base class chains.
+ *
+ * Usage: outputinfo_bench [-t <ms per benchmark>] [filter]
+ */
+
+#include "smsdk_ext.h"
+
+IHandleSys *handlesys = NULL;
+IGameConfigManager *gameconfs = NULL;
+IGameHelpers *gamehelpers = NULL;
+ISourceMod *g_pSM = NULL;
+ISourceMod *smutils = NULL;
+IMemoryUtils *memutils = NULL;
+IExtension *myself = NULL;
+IShareSys *sharesys = NULL;
+IPluginManager *plsys = NULL;
+ITextParsers *textparsers = NULL;
+ICvar *g_pCVar = NULL;
+
+#include "extension.cpp"
+
+#include <cstdarg>
+#include <cstdlib>
+
+/**
+ * Synthetic entities. Every entity is one allocation starting with a header
+ * the mock gamehelpers reads, followed by the fields its datamap describes.
+ */
+struct MockEntityHeader
+{
+	datamap_t *pMap;
+	int Index;
+	const char *pClassname;
+	string_t Name; // m_iName
+};
+
+#define MOCK_DATAMAP_DEPTH		16	// base classes between the entity and CBaseEntity
+#define MOCK_DATAMAP_FIELDS		24	// plain fields per class
+#define MOCK_MAX_ENTITIES		64
+
+struct MockClass
+{
+	std::vector<typedescription_t> Fields;
+	std::vector<std::string> Names;
+	datamap_t Map;
+};
+
+MockClass g_aMockClasses[MOCK_DATAMAP_DEPTH];
+size_t g_MockEntitySize = 0;
+CBaseEntity *g_apMockEntities[MOCK_MAX_ENTITIES];
+
+void AddMockField(MockClass &Class, const char *pName, fieldtype_t Type, short Flags, size_t Size)
+{
+	typedescription_t Desc;
+	memset(&Desc, 0, sizeof(Desc));
+	Desc.fieldType = Type;
+	Desc.fieldOffset[TD_OFFSET_NORMAL] = (int)g_MockEntitySize;
+	Desc.fieldSize = 1;
+	Desc.flags = Flags;
+	Desc.fieldSizeInBytes = (int)Size;
+
+	Class.Names.emplace_back(pName);
+	Class.Fields.push_back(Desc);
+	g_MockEntitySize += (Size + 7) & ~7;
+}
+
+/**
+ * Class 0 is the most derived one ("bench_relay" with OnTrigger), the last
+ * one plays CBaseEntity with m_iName and OnUser1-4. Every class in between
+ * adds plain fields and one output of its own.
+ */
+void BuildMockClasses()
+{
+	g_MockEntitySize = sizeof(MockEntityHeader);
+
+	for(int i = MOCK_DATAMAP_DEPTH - 1; i >= 0; i--)
+	{
+		MockClass &Class = g_aMockClasses[i];
+		char aName[64];
+
+		for(int f = 0; f < MOCK_DATAMAP_FIELDS; f++)
+		{
+			snprintf(aName, sizeof(aName), "m_iField%d_%d", i, f);
+			AddMockField(Class, aName, FIELD_INTEGER, 0, sizeof(int));
+		}
+
+		if(i == MOCK_DATAMAP_DEPTH - 1)
+		{
+			// Shares the header's slot so GetEntityName reads it.
+			Class.Names.emplace_back("m_iName");
+			typedescription_t Desc;
+			memset(&Desc, 0, sizeof(Desc));
+			Desc.fieldType = FIELD_STRING;
+			Desc.fieldOffset[TD_OFFSET_NORMAL] = offsetof(MockEntityHeader, Name);
+			Class.Fields.push_back(Desc);
+
+			for(int u = 1; u <= 4; u++)
+			{
+				snprintf(aName, sizeof(aName), "m_OnUser%d", u);
+				AddMockField(Class, aName, FIELD_CUSTOM, FTYPEDESC_OUTPUT, sizeof(CBaseEntityOutput));
+			}
+		}
+		else if(i == 0)
+		{
+			AddMockField(Class, "m_OnTrigger", FIELD_CUSTOM, FTYPEDESC_OUTPUT, sizeof(CBaseEntityOutput));
+		}
+		else
+		{
+			snprintf(aName, sizeof(aName), "m_OnLevel%d", i);
+			AddMockField(Class, aName, FIELD_CUSTOM, FTYPEDESC_OUTPUT, sizeof(CBaseEntityOutput));
+		}
+	}
+
+	for(int i = 0; i < MOCK_DATAMAP_DEPTH; i++)
+	{
+		MockClass &Class = g_aMockClasses[i];
+		for(size_t f = 0; f < Class.Fields.size(); f++)
+		{
+			Class.Fields[f].fieldName = Class.Names[f].c_str();
+			// Like DEFINE_OUTPUT(m_OnTrigger, "OnTrigger"), rules go by the Hammer name.
+			if(Class.Fields[f].flags & FTYPEDESC_OUTPUT)
+				Class.Fields[f].externalName = Class.Fields[f].fieldName + 2;
+		}
+
+		Class.Map.dataDesc = Class.Fields.data();
+		Class.Map.dataNumFields = (int)Class.Fields.size();
+		Class.Map.dataClassName = i == 0 ? "bench_relay" : i == MOCK_DATAMAP_DEPTH - 1 ? "CBaseEntity" : "CBenchBase";
+		Class.Map.baseMap = i + 1 < MOCK_DATAMAP_DEPTH ? &g_aMockClasses[i + 1].Map : NULL;
+	}
+}
+
+CBaseEntity *CreateMockEntity(int Index, const char *pName)
+{
+	// calloc: the outputs' value and action list start out zeroed like in the game.
+	MockEntityHeader *pHeader = (MockEntityHeader *)calloc(1, g_MockEntitySize);
+	pHeader->pMap = &g_aMockClasses[0].Map;
+	pHeader->Index = Index;
+	pHeader->pClassname = "bench_relay";
+	pHeader->Name = AllocOutputString(pName);
+
+	g_apMockEntities[Index] = (CBaseEntity *)pHeader;
+	return (CBaseEntity *)pHeader;
+}
+
+inline MockEntityHeader *MockHeader(CBaseEntity *pEntity)
+{
+	return (MockEntityHeader *)pEntity;
+}
+
+class MockGameHelpers : public IGameHelpers
+{
+public:
+	datamap_t *GetDataMap(CBaseEntity *pEntity)
+	{
+		return MockHeader(pEntity)->pMap;
+	}
+
+	// Plain recursive walk like older SourceMod, only hit on a cache miss.
+	typedescription_t *FindInDataMap(datamap_t *pMap, const char *offset)
+	{
+		for(; pMap != NULL; pMap = pMap->baseMap)
+		{
+			for(int i = 0; i < pMap->dataNumFields; i++)
+			{
+				if(pMap->dataDesc[i].fieldName && !strcmp(pMap->dataDesc[i].fieldName, offset))
+					return &pMap->dataDesc[i];
+			}
+		}
+
+		return NULL;
+	}
+
+	CBaseEntity *ReferenceToEntity(cell_t entRef)
+	{
+		return entRef >= 0 && entRef < MOCK_MAX_ENTITIES ? g_apMockEntities[entRef] : NULL;
+	}
+
+	cell_t EntityToReference(CBaseEntity *pEntity)
+	{
+		return MockHeader(pEntity)->Index;
+	}
+
+	cell_t IndexToReference(int entIndex)
+	{
+		return entIndex;
+	}
+
+	int ReferenceToIndex(cell_t entRef)
+	{
+		return entRef;
+	}
+
+	cell_t ReferenceToBCompatRef(cell_t entRef)
+	{
+		return entRef;
+	}
+
+	cell_t EntityToBCompatRef(CBaseEntity *pEntity)
+	{
+		return MockHeader(pEntity)->Index;
+	}
+
+	const char *GetEntityClassname(CBaseEntity *pEntity)
+	{
+		return MockHeader(pEntity)->pClassname;
+	}
+
+	const char *GetCurrentMap()
+	{
+		return "bench";
+	}
+} g_MockGameHelpers;
+
+/**
+ * Plugin memory is a flat arena addressed by byte offset, strings the
+ * benchmark passes in are copied there once up front.
+ */
+class MockServerTools : public IServerTools
+{
+public:
+	CBaseEntity *FirstEntity()
+	{
+		return Next(0);
+	}
+
+	CBaseEntity *NextEntity(CBaseEntity *pEntity)
+	{
+		return Next(MockHeader(pEntity)->Index + 1);
+	}
+
+private:
+	CBaseEntity *Next(int Index)
+	{
+		for(; Index < MOCK_MAX_ENTITIES; Index++)
+		{
+			if(g_apMockEntities[Index])
+				return g_apMockEntities[Index];
+		}
+
+		return NULL;
+	}
+} g_MockServerTools;
+
+// Only its presence matters, it tells the extension entity creation and removal are tracked.
+class MockSDKHooks : public ISDKHooks
+{
+public:
+	const char *GetInterfaceName() { return SMINTERFACE_SDKHOOKS_NAME; }
+	unsigned int GetInterfaceVersion() { return 0; }
+	void AddEntityListener(ISMEntityListener *listener) {}
+	void RemoveEntityListener(ISMEntityListener *listener) {}
+} g_MockSDKHooks;
+
+class MockPluginContext : public IPluginContext
+{
+public:
+	MockPluginContext() : m_Memory(1 << 16), m_Used(sizeof(cell_t)), m_Errors(0)
+	{
+	}
+
+	cell_t AddString(const char *pString)
+	{
+		size_t Length = strlen(pString) + 1;
+		cell_t Addr = Alloc(Length);
+		memcpy(&m_Memory[Addr], pString, Length);
+		return Addr;
+	}
+
+	cell_t Alloc(size_t Bytes)
+	{
+		cell_t Addr = (cell_t)m_Used;
+		m_Used += (Bytes + sizeof(cell_t) - 1) & ~(sizeof(cell_t) - 1);
+		if(m_Used > m_Memory.size())
+		{
+			fprintf(stderr, "Mock plugin memory exhausted\n");
+			exit(1);
+		}
+		return Addr;
+	}
+
+	// Address 0 plays NULL_STRING.
+	cell_t NullString() const
+	{
+		return 0;
+	}
+
+	int LocalToString(cell_t local_addr, char **addr)
+	{
+		*addr = &m_Memory[local_addr];
+		return SP_ERROR_NONE;
+	}
+
+	int LocalToStringNULL(cell_t local_addr, char **addr)
+	{
+		*addr = local_addr == NullString() ? NULL : &m_Memory[local_addr];
+		return SP_ERROR_NONE;
+	}
+
+	int StringToLocal(cell_t local_addr, size_t bytes, const char *source)
+	{
+		ke::SafeStrcpy(&m_Memory[local_addr], bytes, source);
+		return SP_ERROR_NONE;
+	}
+
+	int StringToLocalUTF8(cell_t local_addr, size_t maxbytes, const char *source, size_t *wrtnbytes)
+	{
+		size_t Length = ke::SafeStrcpy(&m_Memory[local_addr], maxbytes, source);
+		if(wrtnbytes)
+			*wrtnbytes = Length;
+		return SP_ERROR_NONE;
+	}
+
+	int LocalToPhysAddr(cell_t local_addr, cell_t **phys_addr)
+	{
+		*phys_addr = (cell_t *)&m_Memory[local_addr];
+		return SP_ERROR_NONE;
+	}
+
+	cell_t ThrowNativeError(const char *msg, ...)
+	{
+		if(!m_Errors++)
+		{
+			va_list ap;
+			va_start(ap, msg);
+			fprintf(stderr, "Native error: ");
+			vfprintf(stderr, msg, ap);
+			fprintf(stderr, "\n");
+			va_end(ap);
+		}
+		return 0;
+	}
+
+	void ReportError(const char *fmt, ...)
+	{
+		m_Errors++;
+	}
+
+	int GetLastNativeError()
+	{
+		return m_Errors;
+	}
+
+	IPluginFunction *GetFunctionById(funcid_t func_id)
+	{
+		return NULL;
+	}
+
+	IPluginRuntime *GetRuntime()
+	{
+		return NULL;
+	}
+
+	void *GetIdentity()
+	{
+		return NULL;
+	}
+
+private:
+	std::vector<char> m_Memory;
+	size_t m_Used;
+	int m_Errors;
+} g_MockContext;
+
+/**
+ * ArrayLists. Handles are indexes into g_MockCellArrays, the type is not checked.
+ */
+class MockCellArray : public ICellArray
+{
+public:
+	explicit MockCellArray(size_t BlockSize) : m_BlockSize(BlockSize)
+	{
+	}
+
+	cell_t *push()
+	{
+		m_Data.resize(m_Data.size() + m_BlockSize);
+		return &m_Data[m_Data.size() - m_BlockSize];
+	}
+
+	cell_t *at(size_t index) const
+	{
+		return const_cast<cell_t *>(&m_Data[index * m_BlockSize]);
+	}
+
+	size_t blocksize() const
+	{
+		return m_BlockSize;
+	}
+
+	size_t size() const
+	{
+		return m_Data.size() / m_BlockSize;
+	}
+
+	void clear()
+	{
+		m_Data.clear();
+	}
+
+	bool resize(size_t count)
+	{
+		m_Data.resize(count * m_BlockSize);
+		return true;
+	}
+
+private:
+	std::vector<cell_t> m_Data;
+	size_t m_BlockSize;
+};
+
+std::vector<std::unique_ptr<MockCellArray>> g_MockCellArrays;
+
+Handle_t CreateMockCellArray(size_t BlockSize)
+{
+	g_MockCellArrays.emplace_back(new MockCellArray(BlockSize));
+	return (Handle_t)g_MockCellArrays.size();
+}
+
+class MockHandleSys : public IHandleSys
+{
+public:
+	HandleType_t CreateType(const char *name, IHandleTypeDispatch *dispatch, HandleType_t parent, const void *typeAccess, const void *hndlAccess, IdentityToken_t ident, HandleError *err)
+	{
+		return 1;
+	}
+
+	bool RemoveType(HandleType_t type, IdentityToken_t ident)
+	{
+		return true;
+	}
+
+	bool FindHandleType(const char *name, HandleType_t *type)
+	{
+		*type = 1;
+		return true;
+	}
+
+	Handle_t CreateHandle(HandleType_t type, void *object, IdentityToken_t owner, IdentityToken_t ident, HandleError *err)
+	{
+		return BAD_HANDLE;
+	}
+
+	HandleError ReadHandle(Handle_t handle, HandleType_t type, const HandleSecurity *pSecurity, void **object)
+	{
+		if(handle == BAD_HANDLE || handle > g_MockCellArrays.size())
+			return HandleError_Type;
+
+		*object = static_cast<ICellArray *>(g_MockCellArrays[handle - 1].get());
+		return HandleError_None;
+	}
+
+	HandleError FreeHandle(Handle_t handle, const HandleSecurity *pSecurity)
+	{
+		return HandleError_None;
+	}
+} g_MockHandleSys;
+
+class MockExtension : public IExtension
+{
+public:
+	IdentityToken_t GetIdentity()
+	{
+		return NULL;
+	}
+} g_MockExtension;
+
+void *MockOperatorNew(size_t size)
+{
+	return malloc(size);
+}
+
+void MockOperatorDelete(void *pMem)
+{
+	free(pMem);
+}
+
+SPVM_NATIVE_FUNC FindNative(const char *pName)
+{
+	for(const sp_nativeinfo_t *pNative = MyNatives; pNative->name != NULL; pNative++)
+	{
+		if(!strcmp(pNative->name, pName))
+			return pNative->func;
+	}
+
+	fprintf(stderr, "Unknown native %s\n", pName);
+	exit(1);
+}
+
+/**
+ * Replaces the output's actions with Count fresh ones. Targets cycle through
+ * 16 names, only the last action targets "bench_last".
+ */
+void FillOutput(CBaseEntityOutput *pEntityOutput, int Count)
+{
+	static string_t s_aTargets[16];
+	static string_t s_Last, s_Input, s_Parameter;
+	if(s_Input.pszValue == NULL)
+	{
+		char aName[32];
+		for(int i = 0; i < 16; i++)
+		{
+			snprintf(aName, sizeof(aName), "bench_target%d", i);
+			s_aTargets[i] = AllocOutputString(aName);
+		}
+		s_Last = AllocOutputString("bench_last");
+		s_Input = AllocOutputString("Trigger");
+		s_Parameter = AllocOutputString("1");
+	}
+
+	pEntityOutput->DeleteAllElements();
+
+	CEventAction **ppTail = &pEntityOutput->m_ActionList;
+	for(int i = 0; i < Count; i++)
+	{
+		CEventAction *pAction = CEventAction::Create(i == Count - 1 ? s_Last : s_aTargets[i % 16], s_Input, s_Parameter, 0.0f, -1);
+		*ppTail = pAction;
+		ppTail = &pAction->m_pNext;
+	}
+}
+
+/**
+ * Runs Func in growing batches until MinTime has passed, returns ns/op.
+ */
+std::chrono::milliseconds g_MinTime(200);
+
+template <typename F>
+double MeasureBatched(F Func, uint64_t *pIterations)
+{
+	uint64_t Iterations = 0;
+	uint64_t Batch = 1;
+	std::chrono::nanoseconds Total(0);
+	while(Total < g_MinTime)
+	{
+		auto Start = std::chrono::steady_clock::now();
+		for(uint64_t i = 0; i < Batch; i++)
+			Func();
+		Total += std::chrono::steady_clock::now() - Start;
+
+		Iterations += Batch;
+		if(Batch < (1 << 20))
+			Batch *= 2;
+	}
+
+	*pIterations = Iterations;
+	return (double)Total.count() / Iterations;
+}
+
+/**
+ * For destructive calls: Setup isn't timed, each Func call is timed on its
+ * own and the clock's own overhead is subtracted.
+ */
+template <typename S, typename F>
+double MeasureEach(S Setup, F Func, uint64_t *pIterations)
+{
+	static double s_Overhead = -1.0;
+	if(s_Overhead < 0.0)
+	{
+		const int Samples = 100000;
+		auto Start = std::chrono::steady_clock::now();
+		for(int i = 0; i < Samples; i++)
+			std::chrono::steady_clock::now();
+		s_Overhead = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count() / Samples;
+	}
+
+	uint64_t Iterations = 0;
+	std::chrono::nanoseconds Total(0), Timed(0);
+	while(Total < g_MinTime)
+	{
+		auto SetupStart = std::chrono::steady_clock::now();
+		Setup();
+
+		auto Start = std::chrono::steady_clock::now();
+		Func();
+		auto End = std::chrono::steady_clock::now();
+
+		Timed += End - Start;
+		Total += End - SetupStart;
+		Iterations++;
+	}
+
+	*pIterations = Iterations;
+	double NsPerOp = (double)Timed.count() / Iterations - s_Overhead;
+	return NsPerOp > 0.0 ? NsPerOp : 0.0;
+}
+
+const char *g_pFilter = NULL;
+
+void Report(const char *pName, int Actions, double NsPerOp, uint64_t Iterations)
+{
+	printf("%-42s %8d %14.1f %12llu\n", pName, Actions, NsPerOp, (unsigned long long)Iterations);
+	fflush(stdout);
+}
+
+inline bool Selected(const char *pName)
+{
+	return g_pFilter == NULL || strstr(pName, g_pFilter) != NULL;
+}
+
+#define BENCH_BATCHED(name, actions, call) \
+	if(Selected(name)) \
+	{ \
+		uint64_t Iterations; \
+		double NsPerOp = MeasureBatched([&]() { call; }, &Iterations); \
+		Report(name, actions, NsPerOp, Iterations); \
+	}
+
+#define BENCH_EACH(name, actions, setup, call) \
+	if(Selected(name)) \
+	{ \
+		uint64_t Iterations; \
+		double NsPerOp = MeasureEach([&]() { setup; }, [&]() { call; }, &Iterations); \
+		Report(name, actions, NsPerOp, Iterations); \
+	}
+
+int main(int argc, char **argv)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-t") && i + 1 < argc)
+			g_MinTime = std::chrono::milliseconds(atoi(argv[++i]));
+		else
+			g_pFilter = argv[i];
+	}
+
+	static CGlobalVars s_Globals;
+	static int s_NextIDStamp = 0;
+	gpGlobals = &s_Globals;
+	gamehelpers = &g_MockGameHelpers;
+	handlesys = &g_MockHandleSys;
+	myself = &g_MockExtension;
+	CEventAction::s_pOperatorNewFunc = MockOperatorNew;
+	CEventAction::s_pOperatorDeleteFunc = MockOperatorDelete;
+	CEventAction::s_piNextIDStamp = &s_NextIDStamp;
+
+	BuildMockClasses();
+
+	SPVM_NATIVE_FUNC pGetOutputCount = FindNative("GetOutputCount");
+	SPVM_NATIVE_FUNC pGetOutputCountById = FindNative("GetOutputCountById");
+	SPVM_NATIVE_FUNC pGetOutputTarget = FindNative("GetOutputTarget");
+	SPVM_NATIVE_FUNC pGetOutputDelay = FindNative("GetOutputDelay");
+	SPVM_NATIVE_FUNC pFindOutput = FindNative("FindOutput");
+	SPVM_NATIVE_FUNC pDeleteOutput = FindNative("DeleteOutput");
+	SPVM_NATIVE_FUNC pDeleteAllOutputs = FindNative("DeleteAllOutputs");
+	SPVM_NATIVE_FUNC pDeleteOutputsMatching = FindNative("DeleteOutputsMatching");
+	SPVM_NATIVE_FUNC pGetOutputNames = FindNative("GetOutputNames");
+	SPVM_NATIVE_FUNC pGetOutputNameCount = FindNative("GetOutputNameCount");
+	SPVM_NATIVE_FUNC pGetOutputActions = FindNative("GetOutputActions");
+	SPVM_NATIVE_FUNC pGetEntityOutputs = FindNative("GetEntityOutputs");
+	SPVM_NATIVE_FUNC pGetOutputCountBatch = FindNative("GetOutputCountBatch");
+	SPVM_NATIVE_FUNC pFindOutputBatch = FindNative("FindOutputBatch");
+	SPVM_NATIVE_FUNC pDeleteOutputsMatchingBatch = FindNative("DeleteOutputsMatchingBatch");
+	SPVM_NATIVE_FUNC pResolveOutputTargets = FindNative("ResolveOutputTargets");
+
+	MockPluginContext *pContext = &g_MockContext;
+	cell_t OnTrigger = pContext->AddString("m_OnTrigger");
+	cell_t OnUser1 = pContext->AddString("m_OnUser1");
+	cell_t Missing = pContext->AddString("m_OnMissing");
+	cell_t TargetLast = pContext->AddString("bench_last");
+	cell_t TargetNone = pContext->AddString("bench_none");
+	cell_t Target3 = pContext->AddString("bench_target3");
+	cell_t Buffer = pContext->Alloc(256);
+	cell_t Null = pContext->NullString();
+	cell_t OutputList = CreateMockCellArray(ENTITYOUTPUT_CELLS);
+	cell_t ActionList = CreateMockCellArray(ACTION_CELLS);
+
+	printf("%-42s %8s %14s %12s\n", "benchmark", "actions", "ns/op", "iterations");
+
+	const int aActions[] = { 1, 10, 100, 1000, 10000 };
+	for(size_t a = 0; a < sizeof(aActions) / sizeof(aActions[0]); a++)
+	{
+		int Actions = aActions[a];
+		int Entity = (int)a + 1;
+		CBaseEntity *pEntity = CreateMockEntity(Entity, "bench_entity");
+
+		// OnTrigger sits in the most derived class, OnUser1 at the far end of the chain.
+		CBaseEntityOutput *pOnTrigger = GetOutput(pEntity, "m_OnTrigger");
+		CBaseEntityOutput *pOnUser1 = GetOutput(pEntity, "m_OnUser1");
+		FillOutput(pOnTrigger, Actions);
+		FillOutput(pOnUser1, Actions);
+
+		cell_t OnTriggerId = InternOutputName("m_OnTrigger");
+
+		cell_t CountParams[] = { 2, Entity, OnTrigger };
+		cell_t CountDeepParams[] = { 2, Entity, OnUser1 };
+		cell_t CountMissingParams[] = { 2, Entity, Missing };
+		cell_t CountByIdParams[] = { 2, Entity, OnTriggerId };
+		BENCH_BATCHED("GetOutputCount", Actions, pGetOutputCount(pContext, CountParams));
+		BENCH_BATCHED("GetOutputCount (deep base class)", Actions, pGetOutputCount(pContext, CountDeepParams));
+		BENCH_BATCHED("GetOutputCount (missing output)", Actions, pGetOutputCount(pContext, CountMissingParams));
+		BENCH_BATCHED("GetOutputCountById", Actions, pGetOutputCountById(pContext, CountByIdParams));
+
+		cell_t TargetFirstParams[] = { 5, Entity, OnTrigger, 0, Buffer, 256 };
+		cell_t TargetLastParams[] = { 5, Entity, OnTrigger, Actions - 1, Buffer, 256 };
+		cell_t DelayLastParams[] = { 3, Entity, OnTrigger, Actions - 1 };
+		BENCH_BATCHED("GetOutputTarget (first)", Actions, pGetOutputTarget(pContext, TargetFirstParams));
+		BENCH_BATCHED("GetOutputTarget (last)", Actions, pGetOutputTarget(pContext, TargetLastParams));
+		BENCH_BATCHED("GetOutputDelay (last)", Actions, pGetOutputDelay(pContext, DelayLastParams));
+
+		// Reading every action one index at a time, the way plugins dump outputs.
+		BENCH_BATCHED("GetOutputTarget (all, per action)", Actions,
+			for(int i = 0; i < Actions; i++)
+			{
+				TargetFirstParams[3] = i;
+				pGetOutputTarget(pContext, TargetFirstParams);
+			}
+			TargetFirstParams[3] = 0);
+
+		cell_t FindHitParams[] = { 8, Entity, OnTrigger, 0, TargetLast, Null, Null, sp_ftoc(-1.0f), 0 };
+		cell_t FindMissParams[] = { 8, Entity, OnTrigger, 0, TargetNone, Null, Null, sp_ftoc(-1.0f), 0 };
+		BENCH_BATCHED("FindOutput (hit last)", Actions, pFindOutput(pContext, FindHitParams));
+		BENCH_BATCHED("FindOutput (miss)", Actions, pFindOutput(pContext, FindMissParams));
+
+		cell_t DeleteLastParams[] = { 3, Entity, OnTrigger, Actions - 1 };
+		cell_t DeleteAllParams[] = { 2, Entity, OnTrigger };
+		cell_t DeleteMatchingParams[] = { 7, Entity, OnTrigger, Target3, Null, Null, sp_ftoc(-1.0f), 0 };
+		BENCH_EACH("DeleteOutput (last)", Actions, FillOutput(pOnTrigger, Actions), pDeleteOutput(pContext, DeleteLastParams));
+		BENCH_EACH("DeleteAllOutputs", Actions, FillOutput(pOnTrigger, Actions), pDeleteAllOutputs(pContext, DeleteAllParams));
+		BENCH_EACH("DeleteOutputsMatching (1/16)", Actions, FillOutput(pOnTrigger, Actions), pDeleteOutputsMatching(pContext, DeleteMatchingParams));
+
+		// Whole entity dumps: every output's name and actions.
+		int Outputs = GetDataMapOutputs(&g_aMockClasses[0].Map).size();
+		cell_t NameCountParams[] = { 1, Entity };
+		cell_t NamesParams[] = { 4, Entity, 0, Buffer, 256 };
+		cell_t ActionsParams[] = { 3, Entity, OnTrigger, ActionList };
+		cell_t EntityOutputsParams[] = { 3, Entity, OutputList, ActionList };
+		BENCH_BATCHED("GetOutputNameCount", Actions, pGetOutputNameCount(pContext, NameCountParams));
+		BENCH_BATCHED("Dump (GetOutputNames + GetOutputActions)", Actions,
+			for(int i = 0; i < Outputs; i++)
+			{
+				NamesParams[2] = i;
+				pGetOutputNames(pContext, NamesParams);
+				ActionsParams[2] = Buffer;
+				pGetOutputActions(pContext, ActionsParams);
+			});
+		BENCH_BATCHED("Dump (GetEntityOutputs)", Actions, pGetEntityOutputs(pContext, EntityOutputsParams));
+
+		FillOutput(pOnTrigger, 0);
+		FillOutput(pOnUser1, 0);
+	}
+
+	// One output checked on many entities, one call per entity against one batch call.
+	const int BatchEntities = 48;
+	const int BatchActions = 10;
+	const int FirstBatchEntity = 16;
+
+	cell_t EntitiesAddr = pContext->Alloc(BatchEntities * sizeof(cell_t));
+	cell_t ResultsAddr = pContext->Alloc(BatchEntities * sizeof(cell_t));
+	cell_t *pEntities;
+	pContext->LocalToPhysAddr(EntitiesAddr, &pEntities);
+
+	std::vector<CBaseEntityOutput *> BatchOutputs;
+	for(int i = 0; i < BatchEntities; i++)
+	{
+		pEntities[i] = FirstBatchEntity + i;
+		BatchOutputs.push_back(GetOutput(CreateMockEntity(pEntities[i], "bench_batch"), "m_OnTrigger"));
+		FillOutput(BatchOutputs.back(), BatchActions);
+	}
+
+	auto FillBatch = [&]()
+	{
+		for(CBaseEntityOutput *pEntityOutput : BatchOutputs)
+			FillOutput(pEntityOutput, BatchActions);
+	};
+
+	cell_t LoopCountParams[] = { 2, 0, OnTrigger };
+	cell_t LoopFindParams[] = { 8, 0, OnTrigger, 0, Target3, Null, Null, sp_ftoc(-1.0f), 0 };
+	cell_t LoopDeleteParams[] = { 7, 0, OnTrigger, Target3, Null, Null, sp_ftoc(-1.0f), 0 };
+	cell_t BatchCountParams[] = { 4, EntitiesAddr, BatchEntities, OnTrigger, ResultsAddr };
+	cell_t BatchFindParams[] = { 9, EntitiesAddr, BatchEntities, OnTrigger, ResultsAddr, Target3, Null, Null, sp_ftoc(-1.0f), 0 };
+	cell_t BatchDeleteParams[] = { 9, EntitiesAddr, BatchEntities, OnTrigger, ResultsAddr, Target3, Null, Null, sp_ftoc(-1.0f), 0 };
+
+	BENCH_BATCHED("GetOutputCount x48 (loop)", BatchActions,
+		for(int i = 0; i < BatchEntities; i++)
+		{
+			LoopCountParams[1] = pEntities[i];
+			pGetOutputCount(pContext, LoopCountParams);
+		});
+	BENCH_BATCHED("GetOutputCountBatch x48", BatchActions, pGetOutputCountBatch(pContext, BatchCountParams));
+	BENCH_BATCHED("FindOutput x48 (loop)", BatchActions,
+		for(int i = 0; i < BatchEntities; i++)
+		{
+			LoopFindParams[1] = pEntities[i];
+			pFindOutput(pContext, LoopFindParams);
+		});
+	BENCH_BATCHED("FindOutputBatch x48", BatchActions, pFindOutputBatch(pContext, BatchFindParams));
+	BENCH_EACH("DeleteOutputsMatching x48 (loop)", BatchActions, FillBatch(),
+		for(int i = 0; i < BatchEntities; i++)
+		{
+			LoopDeleteParams[1] = pEntities[i];
+			pDeleteOutputsMatching(pContext, LoopDeleteParams);
+		});
+	BENCH_EACH("DeleteOutputsMatchingBatch x48", BatchActions, FillBatch(), pDeleteOutputsMatchingBatch(pContext, BatchDeleteParams));
+
+	// A map's worth of rules, most of them on outputs these entities don't have.
+	const int Rules = 256;
+	OutputRulesParser RuleParser;
+	SMCStates States = { 0, 0 };
+	RuleParser.ReadSMC_NewSection(&States, "OutputRules");
+	for(int i = 0; i < Rules; i++)
+	{
+		char aName[32], aOutput[32];
+		snprintf(aName, sizeof(aName), "rule%d", i);
+		if(i % 64)
+			snprintf(aOutput, sizeof(aOutput), "OnBenchRule%d", i);
+		else
+			snprintf(aOutput, sizeof(aOutput), "OnTrigger");
+
+		RuleParser.ReadSMC_NewSection(&States, aName);
+		RuleParser.ReadSMC_KeyValue(&States, "output", aOutput);
+		RuleParser.ReadSMC_KeyValue(&States, "target", "bench_target3");
+		RuleParser.ReadSMC_KeyValue(&States, "action", "modify");
+		RuleParser.ReadSMC_KeyValue(&States, "set_delay", "0.0");
+		RuleParser.ReadSMC_LeavingSection(&States);
+	}
+	RuleParser.ReadSMC_LeavingSection(&States);
+
+	FillBatch();
+	BENCH_BATCHED("ApplyOutputRules x48 (256 rules)", BatchActions,
+		for(int i = 0; i < BatchEntities; i++)
+			ApplyOutputRules(GetEntityParam(pEntities[i])));
+	ClearOutputRules();
+
+	// Target resolution through the name index: an exact name, a wildcard and a
+	// classname hit all 48 batch entities, the benchmark entities share the class.
+	static CDetour s_KeyValueDetour;
+	servertools = &g_MockServerTools;
+	g_pSDKHooks = &g_MockSDKHooks;
+	g_pKeyValueDetour = &s_KeyValueDetour;
+
+	const int ResolverEntity = 10;
+	CBaseEntityOutput *pResolverOutput = GetOutput(CreateMockEntity(ResolverEntity, "bench_resolver"), "m_OnTrigger");
+	const char *apResolveTargets[] = { "bench_batch", "bench_b*", "bench_relay", "!self" };
+	const char *apResolveNames[] = { "ResolveOutputTargets (name)", "ResolveOutputTargets (wildcard)", "ResolveOutputTargets (classname)", "ResolveOutputTargets (!self)" };
+	for(const char *pTarget : apResolveTargets)
+		pResolverOutput->InsertElement(-1, CEventAction::Create(AllocOutputString(pTarget), AllocOutputString("Trigger"), NULL_STRING, 0.0f, -1));
+
+	RebuildNameIndex();
+
+	cell_t RefList = CreateMockCellArray(1);
+	cell_t ResolveParams[] = { 4, ResolverEntity, OnTrigger, 0, RefList };
+	for(int i = 0; i < 4; i++)
+	{
+		ResolveParams[3] = i;
+		int Matches = pResolveOutputTargets(pContext, ResolveParams);
+		BENCH_BATCHED(apResolveNames[i], Matches, pResolveOutputTargets(pContext, ResolveParams));
+	}
+
+	BENCH_BATCHED("RebuildNameIndex", 0, RebuildNameIndex());
+
+	if(pContext->GetLastNativeError())
+	{
+		fprintf(stderr, "%d native errors\n", pContext->GetLastNativeError());
+		return 1;
+	}
+
+	return 0;
+}
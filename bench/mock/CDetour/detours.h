@@ -0,0 +1,48 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_DETOURS_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_DETOURS_H_
+
+// Detours are never created in the benchmark, features built on them stay off.
+class CDetour
+{
+public:
+	bool IsEnabled() { return false; }
+	void EnableDetour() {}
+	void DisableDetour() {}
+	void Destroy() {}
+};
+
+class CDetourManager
+{
+public:
+	static void Init(void *spengine, SourceMod::IGameConfig *gameconf) {}
+};
+
+#define DETOUR_DECL_MEMBER0(name, ret) \
+	class name##Class { public: ret name(); static ret (name##Class::* name##_Actual)(); }; \
+	ret (name##Class::* name##Class::name##_Actual)() = NULL; \
+	ret name##Class::name()
+
+#define DETOUR_DECL_MEMBER1(name, ret, p1type, p1name) \
+	class name##Class { public: ret name(p1type); static ret (name##Class::* name##_Actual)(p1type); }; \
+	ret (name##Class::* name##Class::name##_Actual)(p1type) = NULL; \
+	ret name##Class::name(p1type p1name)
+
+#define DETOUR_DECL_MEMBER2(name, ret, p1type, p1name, p2type, p2name) \
+	class name##Class { public: ret name(p1type, p2type); static ret (name##Class::* name##_Actual)(p1type, p2type); }; \
+	ret (name##Class::* name##Class::name##_Actual)(p1type, p2type) = NULL; \
+	ret name##Class::name(p1type p1name, p2type p2name)
+
+#define DETOUR_DECL_MEMBER4(name, ret, p1type, p1name, p2type, p2name, p3type, p3name, p4type, p4name) \
+	class name##Class { public: ret name(p1type, p2type, p3type, p4type); static ret (name##Class::* name##_Actual)(p1type, p2type, p3type, p4type); }; \
+	ret (name##Class::* name##Class::name##_Actual)(p1type, p2type, p3type, p4type) = NULL; \
+	ret name##Class::name(p1type p1name, p2type p2name, p3type p3name, p4type p4name)
+
+#define DETOUR_DECL_MEMBER5(name, ret, p1type, p1name, p2type, p2name, p3type, p3name, p4type, p4name, p5type, p5name) \
+	class name##Class { public: ret name(p1type, p2type, p3type, p4type, p5type); static ret (name##Class::* name##_Actual)(p1type, p2type, p3type, p4type, p5type); }; \
+	ret (name##Class::* name##Class::name##_Actual)(p1type, p2type, p3type, p4type, p5type) = NULL; \
+	ret name##Class::name(p1type p1name, p2type p2name, p3type p3name, p4type p4name, p5type p5name)
+
+#define DETOUR_MEMBER_CALL(name) (this->*name##_Actual)
+#define DETOUR_CREATE_MEMBER(name, gamedata) ((CDetour *)NULL)
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_DETOURS_H_
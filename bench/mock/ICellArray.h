@@ -0,0 +1 @@
+// ICellArray lives in smsdk_ext.h.
@@ -0,0 +1,25 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_ISDKHOOKS_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_ISDKHOOKS_H_
+
+#define SMINTERFACE_SDKHOOKS_NAME "ISDKHooks"
+
+namespace SourceMod
+{
+	class ISMEntityListener
+	{
+	public:
+		virtual void OnEntityCreated(CBaseEntity *pEntity, const char *classname) {}
+		virtual void OnEntityDestroyed(CBaseEntity *pEntity) {}
+	};
+
+	class ISDKHooks : public SMInterface
+	{
+	public:
+		virtual void AddEntityListener(ISMEntityListener *listener) = 0;
+		virtual void RemoveEntityListener(ISMEntityListener *listener) = 0;
+	};
+}
+
+#define SM_GET_LATE_IFACE(prefix, addr) sharesys->RequestInterface(SMINTERFACE_##prefix##_NAME, 0, myself, (SMInterface **)&addr)
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_ISDKHOOKS_H_
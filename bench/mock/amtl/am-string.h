@@ -0,0 +1,28 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_AM_STRING_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_AM_STRING_H_
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace ke
+{
+	inline size_t SafeSprintf(char *buffer, size_t maxlength, const char *fmt, ...)
+	{
+		va_list ap;
+		va_start(ap, fmt);
+		int len = vsnprintf(buffer, maxlength, fmt, ap);
+		va_end(ap);
+
+		if(len < 0 || maxlength == 0)
+			return 0;
+		return (size_t)len >= maxlength ? maxlength - 1 : len;
+	}
+
+	inline size_t SafeStrcpy(char *dest, size_t maxlength, const char *src)
+	{
+		return SafeSprintf(dest, maxlength, "%s", src);
+	}
+}
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_AM_STRING_H_
@@ -0,0 +1,39 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_CONVAR_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_CONVAR_H_
+
+#include <cstdio>
+
+#define CVAR_INTERFACE_VERSION "VEngineCvar004"
+
+class ICvar;
+extern ICvar *icvar;
+extern ICvar *g_pCVar;
+
+class CCommand
+{
+public:
+	int ArgC() const { return m_nArgc; }
+	const char *Arg(int nIndex) const { return nIndex < m_nArgc ? m_ppArgv[nIndex] : ""; }
+
+	int m_nArgc;
+	const char **m_ppArgv;
+};
+
+class ConCommandBase
+{
+};
+
+class IConCommandBaseAccessor
+{
+public:
+	virtual bool RegisterConCommandBase(ConCommandBase *pVar) = 0;
+};
+
+inline void ConVar_Register(int nCVarFlag = 0, IConCommandBaseAccessor *pAccessor = NULL) {}
+inline void ConVar_Unregister() {}
+
+#define CON_COMMAND(name, description) static void name(const CCommand &args)
+#define META_CONPRINTF printf
+#define META_CONPRINT printf
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_CONVAR_H_
@@ -0,0 +1 @@
+// Nothing the extension needs from here.
@@ -0,0 +1,420 @@
+/**
+ * Minimal stand-in for the SourceMod/HL2SDK headers, just enough of them to
+ * compile src/extension.cpp into the standalone benchmark. Interfaces only
+ * declare what the extension calls, bench.cpp implements them.
+ */
+
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_SMSDK_EXT_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_SMSDK_EXT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "smsdk_config.h"
+
+#define SE_CSS					3
+#define SE_LEFT4DEAD			10
+#define SOURCE_ENGINE			SE_CSS
+#define PLATFORM_LINUX
+#define PLATFORM_MAX_PATH		260
+#define NUM_ENT_ENTRIES			4096
+
+#define DECLARE_SIMPLE_DATADESC()
+
+typedef int32_t cell_t;
+typedef uint32_t ucell_t;
+typedef uint32_t funcid_t;
+
+class CBaseEntity;
+class edict_t;
+
+class CGlobalVars
+{
+public:
+	float curtime;
+	int tickcount;
+	float interval_per_tick;
+	int maxEntities;
+};
+
+struct string_t
+{
+	const char *pszValue;
+
+	const char *ToCStr() const { return pszValue ? pszValue : ""; }
+	bool operator==(const string_t &Other) const { return pszValue == Other.pszValue; }
+	bool operator!=(const string_t &Other) const { return pszValue != Other.pszValue; }
+};
+
+#define NULL_STRING string_t()
+#define STRING(s) ((s).ToCStr())
+inline string_t MAKE_STRING(const char *pszValue) { string_t s; s.pszValue = pszValue; return s; }
+#define IDENT_STRINGS(s1, s2) ((s1).pszValue == (s2).pszValue)
+
+struct color32
+{
+	unsigned char r, g, b, a;
+};
+
+class CBaseHandle
+{
+public:
+	unsigned long m_Index;
+
+	int GetEntryIndex() const { return m_Index & (NUM_ENT_ENTRIES - 1); }
+	bool IsValid() const { return m_Index != 0xFFFFFFFF; }
+	unsigned long ToInt() const { return m_Index; }
+	void Term() { m_Index = 0xFFFFFFFF; }
+};
+
+template <class T>
+class CHandle : public CBaseHandle
+{
+};
+
+typedef CHandle<CBaseEntity> EHANDLE;
+
+enum fieldtype_t
+{
+	FIELD_VOID = 0,
+	FIELD_FLOAT,
+	FIELD_STRING,
+	FIELD_VECTOR,
+	FIELD_QUATERNION,
+	FIELD_INTEGER,
+	FIELD_BOOLEAN,
+	FIELD_SHORT,
+	FIELD_CHARACTER,
+	FIELD_COLOR32,
+	FIELD_EMBEDDED,
+	FIELD_CUSTOM,
+	FIELD_CLASSPTR,
+	FIELD_EHANDLE,
+	FIELD_EDICT,
+	FIELD_POSITION_VECTOR,
+	FIELD_TIME,
+	FIELD_TICK,
+	FIELD_MODELNAME,
+	FIELD_SOUNDNAME,
+	FIELD_INPUT,
+	FIELD_FUNCTION,
+	FIELD_VMATRIX,
+	FIELD_VMATRIX_WORLDSPACE,
+	FIELD_MATRIX3X4_WORLDSPACE,
+	FIELD_INTERVAL,
+	FIELD_MODELINDEX,
+	FIELD_MATERIALINDEX,
+	FIELD_TYPECOUNT
+};
+
+#define FTYPEDESC_OUTPUT		0x0010
+#define TD_OFFSET_NORMAL		0
+
+struct datamap_t;
+
+struct typedescription_t
+{
+	fieldtype_t fieldType;
+	const char *fieldName;
+	int fieldOffset[1];
+	unsigned short fieldSize;
+	short flags;
+	const char *externalName;
+	void *pSaveRestoreOps;
+	void *inputFunc;
+	datamap_t *td;
+	int fieldSizeInBytes;
+};
+
+struct datamap_t
+{
+	typedescription_t *dataDesc;
+	int dataNumFields;
+	const char *dataClassName;
+	datamap_t *baseMap;
+};
+
+namespace SourcePawn
+{
+	class IPluginFunction;
+	class IPluginRuntime;
+
+	class IPluginContext
+	{
+	public:
+		virtual int LocalToString(cell_t local_addr, char **addr) = 0;
+		virtual int LocalToStringNULL(cell_t local_addr, char **addr) = 0;
+		virtual int StringToLocal(cell_t local_addr, size_t bytes, const char *source) = 0;
+		virtual int StringToLocalUTF8(cell_t local_addr, size_t maxbytes, const char *source, size_t *wrtnbytes) = 0;
+		virtual int LocalToPhysAddr(cell_t local_addr, cell_t **phys_addr) = 0;
+		virtual cell_t ThrowNativeError(const char *msg, ...) = 0;
+		virtual void ReportError(const char *fmt, ...) = 0;
+		virtual int GetLastNativeError() = 0;
+		virtual IPluginFunction *GetFunctionById(funcid_t func_id) = 0;
+		virtual IPluginRuntime *GetRuntime() = 0;
+		virtual void *GetIdentity() = 0;
+	};
+
+	class IPluginFunction
+	{
+	public:
+		virtual int PushCell(cell_t cell) = 0;
+		virtual int PushFloat(float number) = 0;
+		virtual int PushString(const char *string) = 0;
+		virtual int PushArray(cell_t *inarray, unsigned int cells, int flags = 0) = 0;
+		virtual int Execute(cell_t *result) = 0;
+	};
+
+	class IPluginRuntime
+	{
+	public:
+		virtual IPluginFunction *GetFunctionByName(const char *public_name) = 0;
+	};
+
+	typedef cell_t (*SPVM_NATIVE_FUNC)(IPluginContext *, const cell_t *);
+
+	struct sp_nativeinfo_t
+	{
+		const char *name;
+		SPVM_NATIVE_FUNC func;
+	};
+}
+
+using namespace SourcePawn;
+
+#define SP_ERROR_NONE			0
+
+inline cell_t sp_ftoc(float f) { cell_t c; memcpy(&c, &f, sizeof(c)); return c; }
+inline float sp_ctof(cell_t c) { float f; memcpy(&f, &c, sizeof(f)); return f; }
+
+namespace SourceMod
+{
+	typedef unsigned int Handle_t;
+	typedef unsigned int HandleType_t;
+	typedef void *IdentityToken_t;
+
+	#define BAD_HANDLE			0
+	#define NO_HANDLE_TYPE		0
+
+	enum HandleError
+	{
+		HandleError_None = 0,
+		HandleError_Type,
+	};
+
+	struct HandleSecurity
+	{
+		HandleSecurity() {}
+		HandleSecurity(IdentityToken_t owner, IdentityToken_t ident) : pOwner(owner), pIdentity(ident) {}
+		IdentityToken_t pOwner;
+		IdentityToken_t pIdentity;
+	};
+
+	class IHandleTypeDispatch
+	{
+	public:
+		virtual void OnHandleDestroy(HandleType_t type, void *object) = 0;
+		virtual bool GetHandleApproxSize(HandleType_t type, void *object, unsigned int *pSize) { return false; }
+	};
+
+	class IHandleSys
+	{
+	public:
+		virtual HandleType_t CreateType(const char *name, IHandleTypeDispatch *dispatch, HandleType_t parent, const void *typeAccess, const void *hndlAccess, IdentityToken_t ident, HandleError *err) = 0;
+		virtual bool RemoveType(HandleType_t type, IdentityToken_t ident) = 0;
+		virtual bool FindHandleType(const char *name, HandleType_t *type) = 0;
+		virtual Handle_t CreateHandle(HandleType_t type, void *object, IdentityToken_t owner, IdentityToken_t ident, HandleError *err) = 0;
+		virtual HandleError ReadHandle(Handle_t handle, HandleType_t type, const HandleSecurity *pSecurity, void **object) = 0;
+		virtual HandleError FreeHandle(Handle_t handle, const HandleSecurity *pSecurity) = 0;
+	};
+
+	class IGameConfig
+	{
+	public:
+		virtual bool GetOffset(const char *key, int *value) = 0;
+		virtual bool GetMemSig(const char *key, void **addr) = 0;
+		virtual bool GetAddress(const char *key, void **addr) = 0;
+	};
+
+	class IGameConfigManager
+	{
+	public:
+		virtual bool LoadGameConfigFile(const char *file, IGameConfig **pConfig, char *error, size_t maxlength) = 0;
+		virtual void CloseGameConfigFile(IGameConfig *cfg) = 0;
+	};
+
+	class IGameHelpers
+	{
+	public:
+		virtual datamap_t *GetDataMap(CBaseEntity *pEntity) = 0;
+		virtual typedescription_t *FindInDataMap(datamap_t *pMap, const char *offset) = 0;
+		virtual CBaseEntity *ReferenceToEntity(cell_t entRef) = 0;
+		virtual cell_t EntityToReference(CBaseEntity *pEntity) = 0;
+		virtual cell_t IndexToReference(int entIndex) = 0;
+		virtual int ReferenceToIndex(cell_t entRef) = 0;
+		virtual cell_t ReferenceToBCompatRef(cell_t entRef) = 0;
+		virtual cell_t EntityToBCompatRef(CBaseEntity *pEntity) = 0;
+		virtual const char *GetEntityClassname(CBaseEntity *pEntity) = 0;
+		virtual const char *GetCurrentMap() = 0;
+	};
+
+	enum PathType
+	{
+		Path_None = 0,
+		Path_Game,
+		Path_SM,
+		Path_SM_Rel,
+	};
+
+	typedef void (*GAME_FRAME_HOOK)(bool simulating);
+
+	class ISourceMod
+	{
+	public:
+		virtual size_t BuildPath(PathType type, char *buffer, size_t maxlength, const char *format, ...) = 0;
+		virtual void LogError(void *pExt, const char *format, ...) = 0;
+		virtual void LogMessage(void *pExt, const char *format, ...) = 0;
+		virtual void AddGameFrameHook(GAME_FRAME_HOOK hook) = 0;
+		virtual void RemoveGameFrameHook(GAME_FRAME_HOOK hook) = 0;
+		virtual void *GetScriptingEngine() = 0;
+	};
+
+	class IMemoryUtils
+	{
+	public:
+		virtual void *FindPattern(const void *libPtr, const char *pattern, size_t len) = 0;
+	};
+
+	class IExtension
+	{
+	public:
+		virtual IdentityToken_t GetIdentity() = 0;
+	};
+
+	class SMInterface
+	{
+	public:
+		virtual const char *GetInterfaceName() = 0;
+		virtual unsigned int GetInterfaceVersion() = 0;
+	};
+
+	class IShareSys
+	{
+	public:
+		virtual void AddNatives(IExtension *myself, const sp_nativeinfo_t *natives) = 0;
+		virtual void AddDependency(IExtension *myself, const char *filename, bool require, bool autoload) = 0;
+		virtual bool RequestInterface(const char *iface, unsigned int version, IExtension *pOwner, SMInterface **pIface) = 0;
+	};
+
+	class ICellArray
+	{
+	public:
+		virtual ~ICellArray() {}
+		virtual cell_t *push() = 0;
+		virtual cell_t *at(size_t index) const = 0;
+		virtual size_t blocksize() const = 0;
+		virtual size_t size() const = 0;
+		virtual void clear() = 0;
+		virtual bool resize(size_t count) = 0;
+	};
+
+	enum SMCResult
+	{
+		SMCResult_Continue,
+		SMCResult_Halt,
+		SMCResult_HaltFail
+	};
+
+	enum SMCError
+	{
+		SMCError_Okay = 0,
+		SMCError_StreamOpen,
+		SMCError_StreamError,
+		SMCError_Custom,
+	};
+
+	struct SMCStates
+	{
+		unsigned int line;
+		unsigned int col;
+	};
+
+	class ITextListener_SMC
+	{
+	public:
+		virtual void ReadSMC_ParseStart() {}
+		virtual void ReadSMC_ParseEnd(bool halted, bool failed) {}
+		virtual SMCResult ReadSMC_NewSection(const SMCStates *states, const char *name) { return SMCResult_Continue; }
+		virtual SMCResult ReadSMC_KeyValue(const SMCStates *states, const char *key, const char *value) { return SMCResult_Continue; }
+		virtual SMCResult ReadSMC_LeavingSection(const SMCStates *states) { return SMCResult_Continue; }
+	};
+
+	class ITextParsers
+	{
+	public:
+		virtual SMCError ParseFile_SMC(const char *file, ITextListener_SMC *smc_listener, SMCStates *states) = 0;
+		virtual const char *GetSMCErrorString(SMCError err) = 0;
+	};
+
+	class IPlugin
+	{
+	public:
+		virtual IPluginContext *GetBaseContext() = 0;
+	};
+
+	class IPluginsListener
+	{
+	public:
+		virtual void OnPluginLoaded(IPlugin *plugin) {}
+		virtual void OnPluginUnloaded(IPlugin *plugin) {}
+	};
+
+	class IPluginManager
+	{
+	public:
+		virtual void AddPluginsListener(IPluginsListener *listener) = 0;
+		virtual void RemovePluginsListener(IPluginsListener *listener) = 0;
+	};
+}
+
+using namespace SourceMod;
+
+extern IHandleSys *handlesys;
+extern IGameConfigManager *gameconfs;
+extern IGameHelpers *gamehelpers;
+extern ISourceMod *g_pSM;
+extern ISourceMod *smutils;
+extern IMemoryUtils *memutils;
+extern IExtension *myself;
+extern IShareSys *sharesys;
+extern IPluginManager *plsys;
+extern ITextParsers *textparsers;
+
+#include "convar.h"
+
+class ISmmAPI
+{
+public:
+	virtual CGlobalVars *GetCGlobals() = 0;
+};
+
+#define GET_V_IFACE_ANY(func, var, type, name) var = NULL;
+#define GET_V_IFACE_CURRENT(func, var, type, name) var = NULL;
+#define META_REGCVAR(var) true
+
+class IServerTools;
+
+class SDKExtension
+{
+public:
+	virtual bool SDK_OnLoad(char *error, size_t maxlength, bool late) { return true; }
+	virtual void SDK_OnUnload() {}
+	virtual void SDK_OnAllLoaded() {}
+	virtual bool SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlength, bool late) { return true; }
+	virtual void OnCoreMapStart(edict_t *pEdictList, int edictCount, int clientMax) {}
+	virtual void OnCoreMapEnd() {}
+	virtual void NotifyInterfaceDrop(SMInterface *pInterface) {}
+};
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_SMSDK_EXT_H_
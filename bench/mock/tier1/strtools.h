@@ -0,0 +1,10 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_STRTOOLS_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_STRTOOLS_H_
+
+#include <strings.h>
+#include <ctype.h>
+
+inline int V_stricmp(const char *s1, const char *s2) { return strcasecmp(s1, s2); }
+inline int V_strnicmp(const char *s1, const char *s2, int n) { return strncasecmp(s1, s2, n); }
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_STRTOOLS_H_
@@ -0,0 +1,13 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_ITOOLENTITY_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_ITOOLENTITY_H_
+
+#define VSERVERTOOLS_INTERFACE_VERSION "VSERVERTOOLS001"
+
+class IServerTools
+{
+public:
+	virtual CBaseEntity *FirstEntity() = 0;
+	virtual CBaseEntity *NextEntity(CBaseEntity *pEntity) = 0;
+};
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_ITOOLENTITY_H_
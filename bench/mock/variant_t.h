@@ -0,0 +1,22 @@
+#ifndef _INCLUDE_OUTPUTINFO_MOCK_VARIANT_T_H_
+#define _INCLUDE_OUTPUTINFO_MOCK_VARIANT_T_H_
+
+class variant_t
+{
+public:
+	union
+	{
+		bool bVal;
+		string_t iszVal;
+		int iVal;
+		float flVal;
+		float vecVal[3];
+		color32 rgbaVal;
+	};
+	CHandle<CBaseEntity> eVal;
+	fieldtype_t fieldType;
+
+	variant_t() : iVal(0), fieldType(FIELD_VOID) {}
+};
+
+#endif // _INCLUDE_OUTPUTINFO_MOCK_VARIANT_T_H_
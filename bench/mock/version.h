@@ -0,0 +1 @@
+#define SM_FULL_VERSION "bench"
@@ -30,7 +30,21 @@
  */
 
 #include <amtl/am-string.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include "extension.h"
+#include "outputgraph.h"
 
 /**
  * @file extension.cpp
@@ -42,7 +56,19 @@ Outputinfo g_Outputinfo;		/**< Global singleton for extension's main interface *
 SMEXT_LINK(&g_Outputinfo);
 
 IGameConfig *g_pGameConf = NULL;
-
+IServerTools *servertools = NULL;
+ICvar *icvar = NULL;
+CGlobalVars *gpGlobals = NULL;
+ISDKHooks *g_pSDKHooks = NULL;
+bool g_bLateLoad = false;
+HandleType_t g_CellArrayType = 0;
+HandleType_t g_OutputIteratorType = 0;
+HandleType_t g_OutputFilterType = 0;
+
+#include <ICellArray.h>
+#include <CDetour/detours.h>
+#include <toolframework/itoolentity.h>
+#include <tier1/strtools.h>
 #include <isaverestore.h>
 #include <variant_t.h>
 
@@ -62,6 +88,79 @@ struct varianthax_t
 	fieldtype_t fieldType;
 };
 
+struct EventQueuePrioritizedEvent_t
+{
+	float m_flFireTime;
+	string_t m_iTarget;
+	string_t m_iTargetInput;
+	CBaseHandle m_pActivator;
+	CBaseHandle m_pCaller;
+	int m_iOutputID;
+	CBaseHandle m_pEntTarget; // a pointer to the entity to target; overrides m_iTarget
+
+	varianthax_t m_VariantValue; // variable-type parameter
+
+	EventQueuePrioritizedEvent_t *m_pNext;
+	EventQueuePrioritizedEvent_t *m_pPrev;
+
+	static void (*s_pOperatorDeleteFunc)(void *pMem);
+	static void operator delete(void *pMem);
+};
+
+void (*EventQueuePrioritizedEvent_t::s_pOperatorDeleteFunc)(void *pMem);
+
+void EventQueuePrioritizedEvent_t::operator delete(void *pMem)
+{
+	s_pOperatorDeleteFunc(pMem);
+}
+
+class CEventQueue
+{
+public:
+	EventQueuePrioritizedEvent_t m_Events; // list head, m_Events.m_pNext is the first event
+	int m_iListCount;
+
+	int CancelMatching(bool (*pfnMatches)(EventQueuePrioritizedEvent_t *pEvent, void *pData), void *pData);
+};
+
+int CEventQueue::CancelMatching(bool (*pfnMatches)(EventQueuePrioritizedEvent_t *pEvent, void *pData), void *pData)
+{
+	int Count = 0;
+	EventQueuePrioritizedEvent_t *pNext;
+	for(EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext; pe != NULL; pe = pNext)
+	{
+		pNext = pe->m_pNext;
+		if(!pfnMatches(pe, pData))
+			continue;
+
+		// ServiceEvents holds on to the due head event while its input runs
+		// and frees it afterwards. Plain AddEvent inputs carry no output id,
+		// so we can't tell whether that is happening, just leave it with no
+		// target so it does nothing and the engine removes it.
+		if(pe == m_Events.m_pNext && pe->m_flFireTime <= gpGlobals->curtime)
+		{
+			if(pe->m_iTarget != NULL_STRING || pe->m_pEntTarget.IsValid())
+				Count++;
+
+			pe->m_iTarget = NULL_STRING;
+			pe->m_pEntTarget.Term();
+			continue;
+		}
+
+		pe->m_pPrev->m_pNext = pe->m_pNext;
+		if(pe->m_pNext)
+			pe->m_pNext->m_pPrev = pe->m_pPrev;
+
+		m_iListCount--;
+		delete pe;
+		Count++;
+	}
+
+	return Count;
+}
+
+CEventQueue *g_pEventQueue = NULL;
+
 class CEventAction
 {
 public:
@@ -84,9 +183,18 @@ public:
 	static int *s_pBlocksAllocated;
 	static void **s_ppHeadOfFreeList;
 #else
+	static void *(*s_pOperatorNewFunc)(size_t size);
 	static void (*s_pOperatorDeleteFunc)(void *pMem);
 #endif
+	static int *s_piNextIDStamp;
+
+	// Actions allocated and freed through this extension, for the memory report.
+	static uint64_t s_nCreated;
+	static uint64_t s_nFreed;
 
+	static CEventAction *Create(string_t iTarget, string_t iTargetInput, string_t iParameter, float flDelay, int nTimesToFire);
+	static bool IsSupported();
+	static bool CanCreate();
 	static void operator delete(void *pMem);
 };
 
@@ -94,11 +202,93 @@ public:
 	int *CEventAction::s_pBlocksAllocated;
 	void **CEventAction::s_ppHeadOfFreeList;
 #else
+	void *(*CEventAction::s_pOperatorNewFunc)(size_t size);
 	void (*CEventAction::s_pOperatorDeleteFunc)(void *pMem);
 #endif
+	int *CEventAction::s_piNextIDStamp;
+	uint64_t CEventAction::s_nCreated;
+	uint64_t CEventAction::s_nFreed;
+
+// Without the game's id stamp counter new actions would all be stamped 0,
+// which plugins and chain tracing can't tell apart.
+bool CEventAction::IsSupported()
+{
+	if(s_piNextIDStamp == NULL)
+		return false;
+
+#ifdef PLATFORM_WINDOWS
+	return s_ppHeadOfFreeList != NULL;
+#else
+	return s_pOperatorNewFunc != NULL;
+#endif
+}
+
+// On Windows the pool only grows when the game allocates, so this also fails
+// while its free list is empty.
+bool CEventAction::CanCreate()
+{
+	if(!IsSupported())
+		return false;
+
+#ifdef PLATFORM_WINDOWS
+	return *s_ppHeadOfFreeList != NULL;
+#else
+	return true;
+#endif
+}
+
+cell_t ThrowCreateActionError(IPluginContext *pContext)
+{
+	if(!CEventAction::IsSupported())
+		return pContext->ThrowNativeError("Creating actions is not supported on this game/platform");
+
+	return pContext->ThrowNativeError("The game's action pool has no free blocks left");
+}
+
+/**
+ * Allocates from the game's own CEventAction pool so the engine can free the
+ * action like any other. The constructor lives in the game, so the fields
+ * are filled in here instead.
+ */
+CEventAction *CEventAction::Create(string_t iTarget, string_t iTargetInput, string_t iParameter, float flDelay, int nTimesToFire)
+{
+	if(s_piNextIDStamp == NULL)
+		return NULL;
+
+#ifdef PLATFORM_WINDOWS
+	// We only know the pool's free list, not how to grow it.
+	void *pMem = *s_ppHeadOfFreeList;
+	if(pMem == NULL)
+		return NULL;
+
+	*s_ppHeadOfFreeList = *((void **)pMem);
+	(*s_pBlocksAllocated)++;
+#else
+	if(s_pOperatorNewFunc == NULL)
+		return NULL;
+
+	void *pMem = s_pOperatorNewFunc(sizeof(CEventAction));
+	if(pMem == NULL)
+		return NULL;
+#endif
+
+	CEventAction *pAction = (CEventAction *)pMem;
+	pAction->m_iTarget = iTarget;
+	pAction->m_iTargetInput = iTargetInput;
+	pAction->m_iParameter = iParameter;
+	pAction->m_flDelay = flDelay;
+	pAction->m_nTimesToFire = nTimesToFire;
+	pAction->m_iIDStamp = ++(*s_piNextIDStamp);
+	pAction->m_pNext = NULL;
+
+	s_nCreated++;
+	return pAction;
+}
 
 void CEventAction::operator delete(void *pMem)
 {
+	s_nFreed++;
+
 #ifdef PLATFORM_WINDOWS
 	(*s_pBlocksAllocated)--;
 
@@ -112,6 +302,253 @@ void CEventAction::operator delete(void *pMem)
 #endif
 }
 
+/**
+ * Action criteria shared by FindOutput and the bulk delete natives.
+ * NULL strings, a negative delay and zero times to fire match anything.
+ */
+struct ActionFilter
+{
+	const char *pTarget;
+	const char *pTargetInput;
+	const char *pParameter;
+	float flDelay;
+	int nTimesToFire;
+
+	bool Matches(CEventAction *ev) const;
+};
+
+bool ActionFilter::Matches(CEventAction *ev) const
+{
+	if(pTarget != NULL && strcmp(ev->m_iTarget.ToCStr(), pTarget) != 0)
+		return false;
+
+	if(pTargetInput != NULL && strcmp(ev->m_iTargetInput.ToCStr(), pTargetInput) != 0)
+		return false;
+
+	if(pParameter != NULL && strcmp(ev->m_iParameter.ToCStr(), pParameter) != 0)
+		return false;
+
+	if(flDelay >= 0 && flDelay != ev->m_flDelay)
+		return false;
+
+	if(nTimesToFire != 0 && nTimesToFire != ev->m_nTimesToFire)
+		return false;
+
+	return true;
+}
+
+/**
+ * Matches every action that exactly repeats an earlier one of the same list,
+ * clear Seen before moving on to another list. Strings are compared by their
+ * pooled string_t pointers, so equal text that isn't pooled is never folded.
+ */
+struct DuplicateActionFilter
+{
+	struct Key
+	{
+		const char *pTarget;
+		const char *pTargetInput;
+		const char *pParameter;
+		float flDelay;
+		int nTimesToFire;
+
+		bool operator==(const Key &Other) const
+		{
+			return pTarget == Other.pTarget && pTargetInput == Other.pTargetInput && pParameter == Other.pParameter &&
+				flDelay == Other.flDelay && nTimesToFire == Other.nTimesToFire;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &k) const
+		{
+			size_t Hash = std::hash<const char *>()(k.pTarget);
+			Hash = Hash * 31 + std::hash<const char *>()(k.pTargetInput);
+			Hash = Hash * 31 + std::hash<const char *>()(k.pParameter);
+			Hash = Hash * 31 + std::hash<float>()(k.flDelay);
+			return Hash * 31 + (size_t)k.nTimesToFire;
+		}
+	};
+
+	std::unordered_set<Key, KeyHash> Seen;
+
+	bool Matches(CEventAction *ev)
+	{
+		Key k = { ev->m_iTarget.ToCStr(), ev->m_iTargetInput.ToCStr(), ev->m_iParameter.ToCStr(), ev->m_flDelay, ev->m_nTimesToFire };
+		return !Seen.insert(k).second;
+	}
+};
+
+/**
+ * Matches string_t values against a pattern. Results are memoized by string
+ * pointer: pooled strings never change while the map runs, so after the
+ * first comparison a string is matched by a pointer compare.
+ */
+#define OUTPUTFILTER_NOCASE		(1<<0)
+#define OUTPUTFILTER_PREFIX		(1<<1)
+#define OUTPUTFILTER_WILDCARD	(1<<2)
+
+// Game strings are freed on level shutdown, bumped on map end.
+unsigned int g_StringPoolEpoch = 0;
+
+bool GlobMatch(const char *pPattern, const char *pString, bool NoCase)
+{
+	const char *pStar = NULL;
+	const char *pResume = NULL;
+	while(*pString)
+	{
+		char p = NoCase ? (char)tolower((unsigned char)*pPattern) : *pPattern;
+		char c = NoCase ? (char)tolower((unsigned char)*pString) : *pString;
+
+		if(p == '*')
+		{
+			pStar = pPattern++;
+			pResume = pString;
+		}
+		else if(p == '?' || (p && p == c))
+		{
+			pPattern++;
+			pString++;
+		}
+		else if(pStar)
+		{
+			pPattern = pStar + 1;
+			pString = ++pResume;
+		}
+		else
+			return false;
+	}
+
+	while(*pPattern == '*')
+		pPattern++;
+
+	return !*pPattern;
+}
+
+class StringMatcher
+{
+public:
+	StringMatcher(const char *pPattern, int Flags) :
+		m_bActive(pPattern != NULL),
+		m_Pattern(pPattern ? pPattern : ""),
+		m_Flags(Flags),
+		m_Epoch(g_StringPoolEpoch)
+	{
+		memset(m_aCache, 0, sizeof(m_aCache));
+	}
+
+	bool IsActive() const
+	{
+		return m_bActive;
+	}
+
+	// For strings that aren't pooled, whose pointers can't be cached.
+	bool MatchesUncached(const char *pString) const
+	{
+		return !m_bActive || Compare(pString);
+	}
+
+	bool Matches(string_t iString)
+	{
+		if(!m_bActive)
+			return true;
+
+		const char *pString = iString.ToCStr();
+		if(m_Epoch != g_StringPoolEpoch)
+		{
+			memset(m_aCache, 0, sizeof(m_aCache));
+			m_Epoch = g_StringPoolEpoch;
+		}
+
+		// Multiplicative hash, pooled strings can sit a fixed stride apart.
+		CacheEntry &Entry = m_aCache[((uint32_t)(uintptr_t)pString * 2654435761u >> 16) % CACHE_SIZE];
+		if(Entry.pString == pString)
+			return Entry.bMatch;
+
+		Entry.pString = pString;
+		Entry.bMatch = Compare(pString);
+		return Entry.bMatch;
+	}
+
+private:
+	bool Compare(const char *pString) const
+	{
+		bool NoCase = m_Flags & OUTPUTFILTER_NOCASE;
+		if(m_Flags & OUTPUTFILTER_WILDCARD)
+			return GlobMatch(m_Pattern.c_str(), pString, NoCase);
+
+		if(m_Flags & OUTPUTFILTER_PREFIX)
+		{
+			return NoCase ? V_strnicmp(pString, m_Pattern.c_str(), m_Pattern.size()) == 0
+				: strncmp(pString, m_Pattern.c_str(), m_Pattern.size()) == 0;
+		}
+
+		return NoCase ? V_stricmp(pString, m_Pattern.c_str()) == 0 : strcmp(pString, m_Pattern.c_str()) == 0;
+	}
+
+	enum { CACHE_SIZE = 64 };
+	struct CacheEntry
+	{
+		const char *pString;
+		bool bMatch;
+	};
+
+	bool m_bActive;
+	std::string m_Pattern;
+	int m_Flags;
+	unsigned int m_Epoch;
+	CacheEntry m_aCache[CACHE_SIZE];
+};
+
+/**
+ * ActionFilter compiled once into a handle and reused across calls.
+ */
+class OutputFilter
+{
+public:
+	OutputFilter(const char *pTarget, const char *pTargetInput, const char *pParameter, float flDelay, int nTimesToFire, int Flags) :
+		m_Target(pTarget, Flags),
+		m_TargetInput(pTargetInput, Flags),
+		m_Parameter(pParameter, Flags),
+		m_flDelay(flDelay),
+		m_nTimesToFire(nTimesToFire)
+	{
+	}
+
+	bool Matches(CEventAction *ev)
+	{
+		if(m_flDelay >= 0 && m_flDelay != ev->m_flDelay)
+			return false;
+
+		if(m_nTimesToFire != 0 && m_nTimesToFire != ev->m_nTimesToFire)
+			return false;
+
+		return m_Target.Matches(ev->m_iTarget) && m_TargetInput.Matches(ev->m_iTargetInput) && m_Parameter.Matches(ev->m_iParameter);
+	}
+
+	// Queued events have no delay or times to fire, only the strings are matched.
+	bool MatchesEvent(string_t iTarget, string_t iTargetInput, const char *pParameter)
+	{
+		return m_Target.Matches(iTarget) && m_TargetInput.Matches(iTargetInput) && m_Parameter.MatchesUncached(pParameter);
+	}
+
+private:
+	StringMatcher m_Target;
+	StringMatcher m_TargetInput;
+	StringMatcher m_Parameter;
+	float m_flDelay;
+	int m_nTimesToFire;
+};
+
+// Bumped whenever the extension changes an action list, so anything holding
+// on to CEventAction pointers knows it has to revalidate them.
+unsigned int g_OutputListEpoch = 0;
+
+// Set up further down with FireOutput tracing. Actions the engine consumes
+// only bump the epoch while it is enabled.
+CDetour *g_pFireOutputDetour = NULL;
+
 class CBaseEntityOutput
 {
 public:
@@ -123,6 +560,11 @@ public:
 	CEventAction *GetElement(int Index);
 	int DeleteElement(int Index);
 	int DeleteAllElements(void);
+	template <typename T>
+	int DeleteMatchingElements(T &Filter);
+	void InsertElement(int Index, CEventAction *pEvent);
+
+	void RemoveElement(CEventAction *pPrevEvent, CEventAction *pEvent);
 };
 
 int CBaseEntityOutput::NumberOfElements(void)
@@ -168,13 +610,55 @@ int CBaseEntityOutput::DeleteElement(int Index)
 	if(pEvent == NULL)
 		return 0;
 
+	RemoveElement(pPrevEvent, pEvent);
+	return 1;
+}
+
+template <typename T>
+int CBaseEntityOutput::DeleteMatchingElements(T &Filter)
+{
+	int Count = 0;
+	CEventAction *pPrevEvent = NULL;
+	CEventAction *pEvent = m_ActionList;
+	while(pEvent)
+	{
+		CEventAction *pNext = pEvent->m_pNext;
+		if(Filter.Matches(pEvent))
+		{
+			RemoveElement(pPrevEvent, pEvent);
+			Count++;
+		}
+		else
+			pPrevEvent = pEvent;
+
+		pEvent = pNext;
+	}
+
+	return Count;
+}
+
+void CBaseEntityOutput::InsertElement(int Index, CEventAction *pEvent)
+{
+	// A negative or out of range index appends.
+	CEventAction **ppLink = &m_ActionList;
+	for(int Count = 0; *ppLink != NULL && Count != Index; Count++)
+		ppLink = &(*ppLink)->m_pNext;
+
+	pEvent->m_pNext = *ppLink;
+	*ppLink = pEvent;
+
+	g_OutputListEpoch++;
+}
+
+void CBaseEntityOutput::RemoveElement(CEventAction *pPrevEvent, CEventAction *pEvent)
+{
 	if(pPrevEvent != NULL)
 		pPrevEvent->m_pNext = pEvent->m_pNext;
 	else
 		m_ActionList = pEvent->m_pNext;
 
+	g_OutputListEpoch++;
 	delete pEvent;
-	return 1;
 }
 
 int CBaseEntityOutput::DeleteAllElements(void)
@@ -186,6 +670,7 @@ int CBaseEntityOutput::DeleteAllElements(void)
 	CEventAction *pNext = m_ActionList;
 	// wipe out the head
 	m_ActionList = NULL;
+	g_OutputListEpoch++;
 	while(pNext)
 	{
 		CEventAction *pStrikeThis = pNext;
@@ -197,19 +682,30 @@ int CBaseEntityOutput::DeleteAllElements(void)
 	return Count;
 }
 
-inline int GetDataMapOffset(CBaseEntity *pEnt, const char *pName, typedescription_t **ppTypeDesc=NULL)
+/**
+ * Strings stored in actions have to outlive them. Prefer the game's string
+ * pool, otherwise keep our own copy that is deliberately never freed since
+ * actions referencing it may outlive the extension.
+ */
+string_t (*g_pAllocPooledString)(const char *pszValue) = NULL;
+std::unordered_set<std::string> *g_pOwnStringPool = NULL;
+
+string_t AllocOutputString(const char *pString)
 {
-	datamap_t *pMap = gamehelpers->GetDataMap(pEnt);
-	if(!pMap)
-		return -1;
+	if(!pString[0])
+		return NULL_STRING;
 
-	typedescription_t *pTypeDesc = gamehelpers->FindInDataMap(pMap, pName);
-	if(pTypeDesc == NULL)
-		return -1;
+	if(g_pAllocPooledString)
+		return g_pAllocPooledString(pString);
 
-	if(ppTypeDesc)
-		*ppTypeDesc = pTypeDesc;
+	if(!g_pOwnStringPool)
+		g_pOwnStringPool = new std::unordered_set<std::string>;
+
+	return MAKE_STRING(g_pOwnStringPool->emplace(pString).first->c_str());
+}
 
+inline int GetFieldOffset(typedescription_t *pTypeDesc)
+{
 #if SOURCE_ENGINE >= SE_LEFT4DEAD
 	return pTypeDesc->fieldOffset;
 #else
@@ -217,418 +713,5455 @@ inline int GetDataMapOffset(CBaseEntity *pEnt, const char *pName, typedescriptio
 #endif
 }
 
-const char* GetEntityName(CBaseEntity* pEntity)
+inline bool IsOutputField(typedescription_t *pTypeDesc)
 {
-	static char buffer[256];
-
-	typedescription_t* td = nullptr;
-	int offset = GetDataMapOffset(pEntity, "m_iName", &td);
+	return pTypeDesc->fieldType == FIELD_CUSTOM && (pTypeDesc->flags & FTYPEDESC_OUTPUT);
+}
 
-	if (offset != -1) {
-		string_t name = *(string_t*)((uintptr_t)(pEntity) + offset);
-		if (name.ToCStr() && name.ToCStr()[0] != '\0')
-			return name.ToCStr();
-	}
+/**
+ * Output ids are interned output names, shared by every entity class.
+ * Each datamap_t lazily caches where (if anywhere) an id lives in it,
+ * so resolving an output is a hash lookup instead of a datamap walk.
+ */
+#define OUTPUT_SLOT_UNRESOLVED -2
 
-	snprintf(buffer, sizeof(buffer), "#%d", gamehelpers->EntityToReference(pEntity));
-	return buffer;
-}
+struct OutputSlot
+{
+	int Offset; // -1 if the datamap has no such output
+	typedescription_t *pTypeDesc;
+};
 
-inline CBaseEntityOutput *GetOutput(CBaseEntity *pEntity, const char *pOutput, typedescription_t **ppTypeDesc=NULL)
+struct OutputDesc
 {
-	typedescription_t *pTypeDesc = NULL;
-	int Offset = GetDataMapOffset(pEntity, pOutput, &pTypeDesc);
+	int OutputId;
+	int Offset;
+	typedescription_t *pTypeDesc;
+};
 
-	if(ppTypeDesc)
-		*ppTypeDesc = pTypeDesc;
+struct DataMapCache
+{
+	std::vector<OutputSlot> Slots; // indexed by output id
+	std::vector<OutputDesc> Outputs; // every output of the class, most derived first
+	bool bOutputsBuilt = false;
+	int NameOffset = OUTPUT_SLOT_UNRESOLVED; // m_iName
+};
 
-	if(Offset == -1)
-		return NULL;
+std::vector<std::string> g_OutputNames;
+std::unordered_map<std::string, int> g_OutputIds;
+std::unordered_map<datamap_t *, DataMapCache> g_DataMapCaches;
 
-	if(pTypeDesc->fieldType != FIELD_CUSTOM)
-		return NULL;
+int InternOutputName(const char *pOutput)
+{
+	auto it = g_OutputIds.find(pOutput);
+	if(it != g_OutputIds.end())
+		return it->second;
+
+	int OutputId = (int)g_OutputNames.size();
+	g_OutputNames.emplace_back(pOutput);
+	g_OutputIds.emplace(g_OutputNames.back(), OutputId);
+	return OutputId;
+}
 
-	if(!(pTypeDesc->flags & FTYPEDESC_OUTPUT))
-		return NULL;
+// Unlike InternOutputName this never adds a name, returns -1 for unknown ones.
+int FindOutputId(const char *pOutput)
+{
+	auto it = g_OutputIds.find(pOutput);
+	return it == g_OutputIds.end() ? -1 : it->second;
+}
 
-	return (CBaseEntityOutput *)((intptr_t)pEntity + Offset);
+inline bool IsValidOutputId(int OutputId)
+{
+	return OutputId >= 0 && OutputId < (int)g_OutputNames.size();
 }
 
-cell_t GetOutputCount(IPluginContext *pContext, const cell_t *params)
+inline const char *OutputIdToName(int OutputId)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	return g_OutputNames[OutputId].c_str();
+}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+DataMapCache *GetDataMapCache(datamap_t *pMap)
+{
+	// Most calls in a row hit the same class, skip the hash lookup for those.
+	static datamap_t *s_pLastMap = NULL;
+	static DataMapCache *s_pLastCache = NULL;
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL)
-		return -1;
+	if(pMap != s_pLastMap)
+	{
+		s_pLastCache = &g_DataMapCaches[pMap];
+		s_pLastMap = pMap;
+	}
 
-	return pEntityOutput->NumberOfElements();
+	return s_pLastCache;
 }
 
-cell_t GetOutputTarget(IPluginContext *pContext, const cell_t *params)
+OutputSlot *GetOutputSlot(datamap_t *pMap, int OutputId)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	DataMapCache *pCache = GetDataMapCache(pMap);
+	if(pCache->Slots.size() <= (size_t)OutputId)
+		pCache->Slots.resize(g_OutputNames.size(), { OUTPUT_SLOT_UNRESOLVED, NULL });
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return 0;
+	OutputSlot *pSlot = &pCache->Slots[OutputId];
+	if(pSlot->Offset != OUTPUT_SLOT_UNRESOLVED)
+		return pSlot;
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
+	pSlot->Offset = -1;
+	pSlot->pTypeDesc = gamehelpers->FindInDataMap(pMap, OutputIdToName(OutputId));
+
+	if(pSlot->pTypeDesc != NULL && IsOutputField(pSlot->pTypeDesc))
+		pSlot->Offset = GetFieldOffset(pSlot->pTypeDesc);
+
+	return pSlot;
+}
+
+const std::vector<OutputDesc> &GetDataMapOutputs(datamap_t *pMap)
+{
+	DataMapCache *pCache = GetDataMapCache(pMap);
+	if(pCache->bOutputsBuilt)
+		return pCache->Outputs;
+
+	for(datamap_t *pBaseMap = pMap; pBaseMap != NULL; pBaseMap = pBaseMap->baseMap)
+	{
+		for(int i = 0; i < pBaseMap->dataNumFields; i++)
+		{
+			typedescription_t *pTypeDesc = &pBaseMap->dataDesc[i];
+			if(IsOutputField(pTypeDesc))
+				pCache->Outputs.push_back({ InternOutputName(pTypeDesc->fieldName), GetFieldOffset(pTypeDesc), pTypeDesc });
+		}
+	}
+
+	pCache->bOutputsBuilt = true;
+	return pCache->Outputs;
+}
+
+string_t GetEntityTargetname(CBaseEntity *pEntity)
+{
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return NULL_STRING;
+
+	DataMapCache *pCache = GetDataMapCache(pMap);
+	if(pCache->NameOffset == OUTPUT_SLOT_UNRESOLVED)
+	{
+		typedescription_t *pTypeDesc = gamehelpers->FindInDataMap(pMap, "m_iName");
+		pCache->NameOffset = pTypeDesc ? GetFieldOffset(pTypeDesc) : -1;
+	}
+
+	if(pCache->NameOffset == -1)
+		return NULL_STRING;
+
+	return *(string_t *)((intptr_t)pEntity + pCache->NameOffset);
+}
+
+const char* GetEntityName(CBaseEntity* pEntity)
+{
+	static char buffer[256];
+
+	const char *pName = GetEntityTargetname(pEntity).ToCStr();
+	if (pName && pName[0] != '\0')
+		return pName;
+
+	snprintf(buffer, sizeof(buffer), "#%d", gamehelpers->EntityToReference(pEntity));
+	return buffer;
+}
+
+/**
+ * Finds which output of pEntity pEntityOutput is, returns -1 if it isn't one of its outputs.
+ */
+int IdentifyOutput(CBaseEntity *pEntity, CBaseEntityOutput *pEntityOutput)
+{
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return -1;
+
+	int Offset = (int)((intptr_t)pEntityOutput - (intptr_t)pEntity);
+	for(const OutputDesc &Desc : GetDataMapOutputs(pMap))
+	{
+		if(Desc.Offset == Offset)
+			return Desc.OutputId;
+	}
+
+	return -1;
+}
+
+inline CBaseEntityOutput *GetOutput(CBaseEntity *pEntity, int OutputId, typedescription_t **ppTypeDesc=NULL)
+{
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return NULL;
+
+	OutputSlot *pSlot = GetOutputSlot(pMap, OutputId);
+
+	if(ppTypeDesc)
+		*ppTypeDesc = pSlot->pTypeDesc;
+
+	if(pSlot->Offset == -1)
+		return NULL;
+
+	return (CBaseEntityOutput *)((intptr_t)pEntity + pSlot->Offset);
+}
+
+/**
+ * Looks up a plugin supplied output name. Building the class's output table
+ * interns every output it has, so names that aren't outputs of any class seen
+ * so far (typos, made up names) are never interned and can't grow the tables.
+ */
+int FindEntityOutputId(CBaseEntity *pEntity, const char *pOutput)
+{
+	int OutputId = FindOutputId(pOutput);
+	if(OutputId != -1)
+		return OutputId;
+
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return -1;
+
+	GetDataMapOutputs(pMap);
+	return FindOutputId(pOutput);
+}
+
+inline CBaseEntityOutput *GetOutput(CBaseEntity *pEntity, const char *pOutput, typedescription_t **ppTypeDesc=NULL)
+{
+	int OutputId = FindEntityOutputId(pEntity, pOutput);
+	if(OutputId == -1)
+		return NULL;
+
+	return GetOutput(pEntity, OutputId, ppTypeDesc);
+}
+
+// Bumped whenever a native gets an invalid entity or a missing output, for the native stats.
+unsigned int g_NativeFailures = 0;
+
+inline CBaseEntity *GetEntityParam(cell_t Entity)
+{
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(Entity));
+	if(!pEntity)
+		g_NativeFailures++;
+
+	return pEntity;
+}
+
+// By name *pOutputId is -1 for names no class seen so far has, *ppOutput gets the name either way.
+inline bool GetOutputIdParam(IPluginContext *pContext, cell_t Param, bool ById, int *pOutputId, const char **ppOutput=NULL)
+{
+	if(ById)
+	{
+		*pOutputId = Param;
+		if(!IsValidOutputId(*pOutputId))
+		{
+			pContext->ThrowNativeError("Invalid output id %d", *pOutputId);
+			return false;
+		}
+
+		if(ppOutput)
+			*ppOutput = OutputIdToName(*pOutputId);
+	}
+	else
+	{
+		char *pOutput;
+		pContext->LocalToString(Param, &pOutput);
+		*pOutputId = FindOutputId(pOutput);
+
+		if(ppOutput)
+			*ppOutput = pOutput;
+	}
+
+	return true;
+}
+
+/**
+ * Resolves the output argument of a native, which is either an output name
+ * or an id returned by ResolveOutputId depending on ById.
+ */
+inline CBaseEntityOutput *GetOutputParam(IPluginContext *pContext, CBaseEntity *pEntity, cell_t Param, bool ById, const char **ppOutput=NULL)
+{
+	int OutputId;
+	const char *pOutput;
+	if(!GetOutputIdParam(pContext, Param, ById, &OutputId, &pOutput))
+		return NULL;
+
+	if(ppOutput)
+		*ppOutput = pOutput;
+
+	CBaseEntityOutput *pEntityOutput = ById ? GetOutput(pEntity, OutputId) : GetOutput(pEntity, pOutput);
+	if(pEntityOutput == NULL)
+		g_NativeFailures++;
+
+	return pEntityOutput;
+}
+
+/**
+ * Looks up a plugin ArrayList and checks that its blocks can hold MinBlockSize cells.
+ */
+ICellArray *GetCellArrayParam(IPluginContext *pContext, cell_t Param, size_t MinBlockSize)
+{
+	Handle_t hndl = (Handle_t)Param;
+	HandleSecurity sec(pContext->GetIdentity(), myself->GetIdentity());
+
+	ICellArray *pArray;
+	HandleError err = handlesys->ReadHandle(hndl, g_CellArrayType, &sec, (void **)&pArray);
+	if(err != HandleError_None)
+	{
+		pContext->ThrowNativeError("Invalid ArrayList handle %x (error %d)", hndl, err);
+		return NULL;
+	}
+
+	if(pArray->blocksize() < MinBlockSize)
+	{
+		pContext->ThrowNativeError("ArrayList block size %d is too small, need at least %d", (int)pArray->blocksize(), (int)MinBlockSize);
+		return NULL;
+	}
+
+	return pArray;
+}
+
+/**
+ * Reads the target, input, parameter, delay, times to fire argument group
+ * starting at params[First].
+ */
+void ReadActionFilterParams(IPluginContext *pContext, const cell_t *params, int First, ActionFilter *pFilter)
+{
+	char *pString;
+	pContext->LocalToStringNULL(params[First], &pString);
+	pFilter->pTarget = pString;
+	pContext->LocalToStringNULL(params[First + 1], &pString);
+	pFilter->pTargetInput = pString;
+	pContext->LocalToStringNULL(params[First + 2], &pString);
+	pFilter->pParameter = pString;
+	pFilter->flDelay = sp_ctof(params[First + 3]);
+	pFilter->nTimesToFire = params[First + 4];
+}
+
+/**
+ * Cell layout of enum struct OutputAction in outputinfo.inc.
+ */
+#define ACTION_TARGET			0	// char[64]
+#define ACTION_TARGETINPUT		16	// char[64]
+#define ACTION_PARAMETER		32	// char[256]
+#define ACTION_DELAY			96
+#define ACTION_TIMESTOFIRE		97
+#define ACTION_IDSTAMP			98
+#define ACTION_CELLS			99
+
+void WriteOutputAction(cell_t *pBlock, CEventAction *pAction)
+{
+	ke::SafeStrcpy((char *)&pBlock[ACTION_TARGET], (ACTION_TARGETINPUT - ACTION_TARGET) * sizeof(cell_t), pAction->m_iTarget.ToCStr());
+	ke::SafeStrcpy((char *)&pBlock[ACTION_TARGETINPUT], (ACTION_PARAMETER - ACTION_TARGETINPUT) * sizeof(cell_t), pAction->m_iTargetInput.ToCStr());
+	ke::SafeStrcpy((char *)&pBlock[ACTION_PARAMETER], (ACTION_DELAY - ACTION_PARAMETER) * sizeof(cell_t), pAction->m_iParameter.ToCStr());
+	pBlock[ACTION_DELAY] = sp_ftoc(pAction->m_flDelay);
+	pBlock[ACTION_TIMESTOFIRE] = pAction->m_nTimesToFire;
+	pBlock[ACTION_IDSTAMP] = pAction->m_iIDStamp;
+}
+
+/**
+ * Calls Func(pTypeDesc, pEntityOutput) for every output of the entity.
+ */
+template <typename F>
+void ForEachEntityOutput(CBaseEntity *pEntity, F Func)
+{
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return;
+
+	for(const OutputDesc &Desc : GetDataMapOutputs(pMap))
+		Func(Desc.pTypeDesc, (CBaseEntityOutput *)((intptr_t)pEntity + Desc.Offset));
+}
+
+/**
+ * Map-wide index of which actions fire at which target name, keyed by the
+ * lowercased target like the engine's own name matching. Entities are
+ * reindexed lazily: whatever may have changed an entity's outputs marks it
+ * dirty and the next lookup reindexes just that entity.
+ */
+struct OutputLink
+{
+	cell_t EntityRef;
+	int OutputId;
+	int Index;
+	CEventAction *pAction; // only compared, to spot links the engine shifted
+	int IDStamp;
+};
+
+std::unordered_map<std::string, std::vector<OutputLink>> g_TargetIndex;
+std::set<std::string> g_WildcardTargets; // keys cut after their first '*'
+std::unordered_map<cell_t, std::vector<std::string>> g_IndexedEntities; // ref -> keys it has links under
+std::unordered_set<cell_t> g_DirtyEntities;
+bool g_bTargetIndexValid = false;
+
+std::string GetTargetKey(const char *pTarget)
+{
+	std::string Key(pTarget);
+	for(char &c : Key)
+		c = (char)tolower((unsigned char)c);
+
+	return Key;
+}
+
+// The engine stops comparing at the first '*', "relay_*_a" hits everything starting with "relay_".
+std::string GetActionTargetKey(const char *pTarget)
+{
+	std::string Key = GetTargetKey(pTarget);
+	size_t Star = Key.find('*');
+	if(Star != std::string::npos)
+		Key.resize(Star + 1);
+
+	return Key;
+}
+
+void IndexEntityOutputs(CBaseEntity *pEntity)
+{
+	cell_t EntityRef = gamehelpers->EntityToReference(pEntity);
+	std::vector<std::string> Keys;
+
+	ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+	{
+		if(pEntityOutput->m_ActionList == NULL)
+			return;
+
+		int OutputId = InternOutputName(pTypeDesc->fieldName);
+		int Index = 0;
+		for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext, Index++)
+		{
+			const char *pTarget = ev->m_iTarget.ToCStr();
+			if(!pTarget[0])
+				continue;
+
+			std::string Key = GetActionTargetKey(pTarget);
+			g_TargetIndex[Key].push_back({ EntityRef, OutputId, Index, ev, ev->m_iIDStamp });
+
+			if(Key.back() == '*')
+				g_WildcardTargets.insert(Key);
+
+			if(std::find(Keys.begin(), Keys.end(), Key) == Keys.end())
+				Keys.push_back(Key);
+		}
+	});
+
+	if(!Keys.empty())
+		g_IndexedEntities[EntityRef] = std::move(Keys);
+}
+
+void UnindexEntityOutputs(cell_t EntityRef)
+{
+	auto it = g_IndexedEntities.find(EntityRef);
+	if(it == g_IndexedEntities.end())
+		return;
+
+	for(const std::string &Key : it->second)
+	{
+		auto Bucket = g_TargetIndex.find(Key);
+		if(Bucket == g_TargetIndex.end())
+			continue;
+
+		std::vector<OutputLink> &Links = Bucket->second;
+		Links.erase(std::remove_if(Links.begin(), Links.end(),
+			[EntityRef](const OutputLink &Link) { return Link.EntityRef == EntityRef; }), Links.end());
+
+		if(Links.empty())
+		{
+			g_WildcardTargets.erase(Key);
+			g_TargetIndex.erase(Bucket);
+		}
+	}
+
+	g_IndexedEntities.erase(it);
+}
+
+void RebuildTargetIndex()
+{
+	g_TargetIndex.clear();
+	g_WildcardTargets.clear();
+	g_IndexedEntities.clear();
+	g_DirtyEntities.clear();
+
+	if(servertools == NULL)
+		return;
+
+	for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+		IndexEntityOutputs(pEntity);
+
+	g_bTargetIndexValid = true;
+}
+
+void InvalidateTargetIndex()
+{
+	g_TargetIndex.clear();
+	g_WildcardTargets.clear();
+	g_IndexedEntities.clear();
+	g_DirtyEntities.clear();
+	g_bTargetIndexValid = false;
+}
+
+void FlushTargetIndex()
+{
+	// Without SDKHooks we never hear about entities coming and going.
+	if(!g_bTargetIndexValid || g_pSDKHooks == NULL)
+	{
+		RebuildTargetIndex();
+		return;
+	}
+
+	for(cell_t EntityRef : g_DirtyEntities)
+	{
+		UnindexEntityOutputs(EntityRef);
+
+		CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(EntityRef);
+		if(pEntity)
+			IndexEntityOutputs(pEntity);
+	}
+
+	g_DirtyEntities.clear();
+}
+
+void MarkEntityOutputsChanged(CBaseEntity *pEntity)
+{
+	if(g_bTargetIndexValid)
+		g_DirtyEntities.insert(gamehelpers->EntityToReference(pEntity));
+}
+
+/**
+ * Entities by lowercased targetname and classname, kept up to date as
+ * entities spawn, die and get renamed through keyvalues. Resolves output
+ * targets like the event queue does: names first, classnames if no name
+ * matches, and anything after a * matches.
+ */
+struct EntityNameIndex
+{
+	std::unordered_map<std::string, std::vector<cell_t>> Entities;
+	std::set<std::string> Keys; // sorted for prefix lookups
+
+	void Add(const std::string &Key, cell_t EntityRef)
+	{
+		std::vector<cell_t> &Refs = Entities[Key];
+		if(Refs.empty())
+			Keys.insert(Key);
+
+		Refs.push_back(EntityRef);
+	}
+
+	void Remove(const std::string &Key, cell_t EntityRef)
+	{
+		auto it = Entities.find(Key);
+		if(it == Entities.end())
+			return;
+
+		std::vector<cell_t> &Refs = it->second;
+		auto Ref = std::find(Refs.begin(), Refs.end(), EntityRef);
+		if(Ref != Refs.end())
+		{
+			*Ref = Refs.back();
+			Refs.pop_back();
+		}
+
+		if(Refs.empty())
+		{
+			Keys.erase(Key);
+			Entities.erase(it);
+		}
+	}
+
+	void Clear()
+	{
+		Entities.clear();
+		Keys.clear();
+	}
+
+	// Calls Func(EntityRef) for every entity matching the lowercased pattern, returns the number of matches.
+	template <typename F>
+	int ForEachMatch(const std::string &Pattern, F Func) const
+	{
+		int Count = 0;
+		size_t Star = Pattern.find('*');
+		if(Star == std::string::npos)
+		{
+			auto it = Entities.find(Pattern);
+			if(it == Entities.end())
+				return 0;
+
+			for(cell_t EntityRef : it->second)
+				Func(EntityRef);
+			return (int)it->second.size();
+		}
+
+		std::string Prefix = Pattern.substr(0, Star);
+		for(auto Key = Keys.lower_bound(Prefix); Key != Keys.end() && Key->compare(0, Prefix.size(), Prefix) == 0; ++Key)
+		{
+			for(cell_t EntityRef : Entities.find(*Key)->second)
+			{
+				Func(EntityRef);
+				Count++;
+			}
+		}
+
+		return Count;
+	}
+};
+
+struct IndexedEntityNames
+{
+	cell_t EntityRef;
+	string_t iName; // as indexed, to spot renames that bypassed KeyValue
+	std::string Name;
+	std::string Classname;
+};
+
+IndexedEntityNames g_IndexedEntityNames[NUM_ENT_ENTRIES];
+EntityNameIndex g_EntitiesByName;
+EntityNameIndex g_EntitiesByClassname;
+bool g_bNameIndexValid = false;
+
+// Set up further down with the rest of the KeyValue hook, renames arrive through it.
+CDetour *g_pKeyValueDetour = NULL;
+
+void UnindexEntityName(cell_t EntityRef)
+{
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(Index < 0 || Index >= NUM_ENT_ENTRIES || g_IndexedEntityNames[Index].EntityRef != EntityRef)
+		return;
+
+	IndexedEntityNames &Entry = g_IndexedEntityNames[Index];
+	if(!Entry.Name.empty())
+		g_EntitiesByName.Remove(Entry.Name, EntityRef);
+	g_EntitiesByClassname.Remove(Entry.Classname, EntityRef);
+
+	Entry.EntityRef = 0;
+	Entry.iName = NULL_STRING;
+	Entry.Name.clear();
+	Entry.Classname.clear();
+}
+
+void IndexEntityName(CBaseEntity *pEntity)
+{
+	cell_t EntityRef = gamehelpers->EntityToReference(pEntity);
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(Index < 0 || Index >= NUM_ENT_ENTRIES)
+		return;
+
+	// Also drops whatever held the slot before, should its destruction have gone unnoticed.
+	IndexedEntityNames &Entry = g_IndexedEntityNames[Index];
+	if(Entry.EntityRef)
+		UnindexEntityName(Entry.EntityRef);
+
+	Entry.EntityRef = EntityRef;
+	Entry.iName = GetEntityTargetname(pEntity);
+	Entry.Name = GetTargetKey(Entry.iName.ToCStr());
+	Entry.Classname = GetTargetKey(gamehelpers->GetEntityClassname(pEntity));
+
+	if(!Entry.Name.empty())
+		g_EntitiesByName.Add(Entry.Name, EntityRef);
+	g_EntitiesByClassname.Add(Entry.Classname, EntityRef);
+}
+
+void RebuildNameIndex()
+{
+	for(IndexedEntityNames &Entry : g_IndexedEntityNames)
+	{
+		Entry.EntityRef = 0;
+		Entry.iName = NULL_STRING;
+		Entry.Name.clear();
+		Entry.Classname.clear();
+	}
+
+	g_EntitiesByName.Clear();
+	g_EntitiesByClassname.Clear();
+
+	if(servertools == NULL)
+		return;
+
+	for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+		IndexEntityName(pEntity);
+
+	g_bNameIndexValid = true;
+}
+
+void InvalidateNameIndex()
+{
+	g_EntitiesByName.Clear();
+	g_EntitiesByClassname.Clear();
+	g_bNameIndexValid = false;
+}
+
+void FlushNameIndex()
+{
+	// SDKHooks tells us about entities coming and going and the KeyValue
+	// detour about renames, without either of them rebuild every time.
+	if(!g_bNameIndexValid || g_pSDKHooks == NULL || g_pKeyValueDetour == NULL)
+		RebuildNameIndex();
+}
+
+/**
+ * Indexes an entity again if it died or its name changed since it was
+ * indexed, returns whether it did.
+ */
+bool RefreshEntityName(cell_t EntityRef)
+{
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(EntityRef);
+	if(!pEntity)
+	{
+		UnindexEntityName(EntityRef);
+		return true;
+	}
+
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(GetEntityTargetname(pEntity) == g_IndexedEntityNames[Index].iName)
+		return false;
+
+	IndexEntityName(pEntity);
+	return true;
+}
+
+/**
+ * Calls Func(EntityRef) for every entity an action targeting pTarget would
+ * hit when fired by pCaller, returns the number of entities. !self and
+ * !caller resolve to pCaller, other ! names depend on the activator and
+ * resolve to nothing.
+ */
+template <typename F>
+int ForEachOutputTarget(CBaseEntity *pCaller, const char *pTarget, F Func)
+{
+	if(!pTarget[0])
+		return 0;
+
+	if(pTarget[0] == '!')
+	{
+		if(V_stricmp(pTarget, "!self") && V_stricmp(pTarget, "!caller"))
+			return 0;
+
+		Func(gamehelpers->EntityToReference(pCaller));
+		return 1;
+	}
+
+	FlushNameIndex();
+
+	std::string Key = GetTargetKey(pTarget);
+	std::vector<cell_t> Matches;
+	auto Collect = [&](cell_t EntityRef) { Matches.push_back(EntityRef); };
+	g_EntitiesByName.ForEachMatch(Key, Collect);
+
+	// SetEntPropString and the game's own SetName don't go through KeyValue.
+	// Matches renamed since are caught here, entities renamed to a matching
+	// name aren't.
+	bool bStale = false;
+	for(cell_t EntityRef : Matches)
+		bStale |= RefreshEntityName(EntityRef);
+
+	if(bStale)
+	{
+		Matches.clear();
+		g_EntitiesByName.ForEachMatch(Key, Collect);
+	}
+
+	if(Matches.empty())
+		return g_EntitiesByClassname.ForEachMatch(Key, Func);
+
+	for(cell_t EntityRef : Matches)
+		Func(EntityRef);
+
+	return (int)Matches.size();
+}
+
+/**
+ * Plugins subscribe to OnEntityOutputChanged per output (or for all of them),
+ * so a change nobody asked about never reaches a plugin.
+ */
+enum OutputChange
+{
+	OutputChange_Added = 0,
+	OutputChange_Removed,
+	OutputChange_Consumed,
+	OutputChange_Modified
+};
+
+#define OUTPUTSUBSCRIPTION_PENDING	-2
+
+/**
+ * Names no class has shown so far aren't interned, they are kept as given
+ * and resolved case-insensitively once a change to such an output comes in.
+ */
+struct OutputSubscription
+{
+	IPluginContext *pContext;
+	IPluginFunction *pFunction;
+	int OutputId; // -1 for every output, OUTPUTSUBSCRIPTION_PENDING while Output is unresolved
+	std::string Output;
+
+	const char *Name() const
+	{
+		return OutputId == OUTPUTSUBSCRIPTION_PENDING ? Output.c_str() : OutputId == -1 ? "*" : OutputIdToName(OutputId);
+	}
+
+	bool Matches(int Id)
+	{
+		if(OutputId == OUTPUTSUBSCRIPTION_PENDING && !V_stricmp(Output.c_str(), OutputIdToName(Id)))
+		{
+			OutputId = Id;
+			Output.clear();
+		}
+
+		return OutputId == -1 || OutputId == Id;
+	}
+};
+
+std::vector<OutputSubscription> g_OutputSubscriptions;
+
+void NotifyOutputChanged(CBaseEntity *pEntity, int OutputId, OutputChange Kind)
+{
+	if(g_OutputSubscriptions.empty() || OutputId == -1)
+		return;
+
+	// Callbacks may subscribe, unsubscribe or change outputs themselves.
+	std::vector<IPluginFunction *> Functions;
+	for(OutputSubscription &Subscription : g_OutputSubscriptions)
+	{
+		if(Subscription.Matches(OutputId))
+			Functions.push_back(Subscription.pFunction);
+	}
+
+	cell_t Entity = gamehelpers->EntityToBCompatRef(pEntity);
+	for(IPluginFunction *pFunction : Functions)
+	{
+		pFunction->PushCell(Entity);
+		pFunction->PushString(OutputIdToName(OutputId));
+		pFunction->PushCell(Kind);
+		pFunction->Execute(NULL);
+	}
+}
+
+inline void NotifyOutputChanged(CBaseEntity *pEntity, CBaseEntityOutput *pEntityOutput, OutputChange Kind)
+{
+	if(!g_OutputSubscriptions.empty())
+		NotifyOutputChanged(pEntity, IdentifyOutput(pEntity, pEntityOutput), Kind);
+}
+
+/**
+ * Every output native comes in a by-name and a by-id flavour sharing one body.
+ */
+#define OUTPUT_NATIVE(name) \
+	cell_t name(IPluginContext *pContext, const cell_t *params) \
+	{ \
+		return name##Impl(pContext, params, false); \
+	} \
+	cell_t name##ById(IPluginContext *pContext, const cell_t *params) \
+	{ \
+		return name##Impl(pContext, params, true); \
+	}
+
+cell_t ResolveOutputId(IPluginContext *pContext, const cell_t *params)
+{
+	char *pOutput;
+	pContext->LocalToString(params[2], &pOutput);
+
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	int OutputId = FindEntityOutputId(pEntity, pOutput);
+	if(OutputId == -1 || GetOutput(pEntity, OutputId) == NULL)
+		return -1;
+
+	return OutputId;
+}
+
+cell_t GetOutputCountImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	return pEntityOutput->NumberOfElements();
+}
+OUTPUT_NATIVE(GetOutputCount)
+
+cell_t GetOutputTargetImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return 0;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iTarget.ToCStr(), &Length);
+
+	return Length;
+}
+OUTPUT_NATIVE(GetOutputTarget)
+
+cell_t GetOutputTargetInputImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return 0;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iTargetInput.ToCStr(), &Length);
+
+	return Length;
+}
+OUTPUT_NATIVE(GetOutputTargetInput)
+
+cell_t GetOutputParameterImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return 0;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iParameter.ToCStr(), &Length);
+
+	return Length;
+}
+OUTPUT_NATIVE(GetOutputParameter)
+
+cell_t GetOutputDelayImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return -1;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(!pAction)
+		return -1;
+
+	return *(cell_t *)&pAction->m_flDelay;
+}
+OUTPUT_NATIVE(GetOutputDelay)
+
+cell_t GetOutputFormattedImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return 0;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(!pAction)
+		return 0;
+
+	char aBuffer[1024];
+	ke::SafeSprintf(aBuffer, sizeof(aBuffer), "%s,%s,%s,%g,%d",
+		pAction->m_iTarget.ToCStr(),
+		pAction->m_iTargetInput.ToCStr(),
+		pAction->m_iParameter.ToCStr(),
+		pAction->m_flDelay,
+		pAction->m_nTimesToFire);
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[4], params[5], aBuffer, &Length);
+
+	return Length;
+}
+OUTPUT_NATIVE(GetOutputFormatted)
+
+cell_t GetOutputValueImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	const char *pOutput;
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById, &pOutput);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	switch(pEntityOutput->m_Value.fieldType)
+	{
+	case FIELD_TICK:
+	case FIELD_MODELINDEX:
+	case FIELD_MATERIALINDEX:
+	case FIELD_INTEGER:
+	case FIELD_COLOR32:
+	case FIELD_SHORT:
+	case FIELD_CHARACTER:
+	case FIELD_BOOLEAN:
+		break;
+	default:
+		return pContext->ThrowNativeError("Entity '%s': %s value is not an integer (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+	}
+
+	return (cell_t)pEntityOutput->m_Value.iVal;
+}
+OUTPUT_NATIVE(GetOutputValue)
+
+cell_t GetOutputValueFloatImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	const char *pOutput;
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById, &pOutput);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	switch(pEntityOutput->m_Value.fieldType)
+	{
+	case FIELD_FLOAT:
+	case FIELD_TIME:
+		break;
+	default:
+		return pContext->ThrowNativeError("Entity '%s': %s value is not a float (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+	}
+
+	return sp_ftoc((cell_t)pEntityOutput->m_Value.flVal);
+}
+OUTPUT_NATIVE(GetOutputValueFloat)
+
+cell_t GetOutputValueStringImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	const char *pOutput;
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById, &pOutput);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	switch(pEntityOutput->m_Value.fieldType)
+	{
+	case FIELD_CHARACTER:
+	case FIELD_STRING:
+	case FIELD_MODELNAME:
+	case FIELD_SOUNDNAME:
+		break;
+	default:
+		return pContext->ThrowNativeError("Entity '%s': %s value is not a string (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+		
+	}
+
+	size_t len;
+	pContext->StringToLocalUTF8(params[3], params[4], pEntityOutput->m_Value.iszVal.ToCStr(), &len);
+
+	return len;
+}
+OUTPUT_NATIVE(GetOutputValueString)
+
+cell_t GetOutputValueVectorImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	const char *pOutput;
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById, &pOutput);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	switch(pEntityOutput->m_Value.fieldType)
+	{
+	case FIELD_FLOAT:
+	case FIELD_TIME:
+		break;
+	default:
+		return pContext->ThrowNativeError("Entity '%s': %s value is not a float (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+	}
+
+	cell_t *vec;
+	pContext->LocalToPhysAddr(params[3], &vec);
+
+	vec[0] = sp_ftoc(pEntityOutput->m_Value.vecVal[0]);
+	vec[1] = sp_ftoc(pEntityOutput->m_Value.vecVal[1]);
+	vec[2] = sp_ftoc(pEntityOutput->m_Value.vecVal[2]);
+
+	return 1;
+}
+OUTPUT_NATIVE(GetOutputValueVector)
+
+cell_t FindOutputImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return -1;
+
+	ActionFilter Filter;
+	ReadActionFilterParams(pContext, params, 4, &Filter);
+
+	int StartCount = params[3];
+	int Count = 0;
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+	{
+		Count++;
+		if(StartCount > 0)
+		{
+			StartCount--;
+			continue;
+		}
+
+		if(!Filter.Matches(ev))
+			continue;
+
+		return Count - 1;
+	}
+
+	return -1;
+}
+OUTPUT_NATIVE(FindOutput)
+
+cell_t DeleteOutputImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return -1;
+
+	int Count = pEntityOutput->DeleteElement(params[3]);
+	if(Count)
+	{
+		MarkEntityOutputsChanged(pEntity);
+		NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+	}
+
+	return Count;
+}
+OUTPUT_NATIVE(DeleteOutput)
+
+cell_t DeleteAllOutputsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
 	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
+		return -1;
+
+	int Count = pEntityOutput->DeleteAllElements();
+	MarkEntityOutputsChanged(pEntity);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+
+	return Count;
+}
+OUTPUT_NATIVE(DeleteAllOutputs)
+
+cell_t DeleteOutputsMatchingImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	ActionFilter Filter;
+	ReadActionFilterParams(pContext, params, 3, &Filter);
+
+	int Count = pEntityOutput->DeleteMatchingElements(Filter);
+	if(Count)
+	{
+		MarkEntityOutputsChanged(pEntity);
+		NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+	}
+
+	return Count;
+}
+OUTPUT_NATIVE(DeleteOutputsMatching)
+
+cell_t DeleteEntityOutputsMatching(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	ActionFilter Filter;
+	ReadActionFilterParams(pContext, params, 2, &Filter);
+
+	int Count = 0;
+	std::vector<int> Changed;
+	ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+	{
+		int Deleted = pEntityOutput->DeleteMatchingElements(Filter);
+		if(Deleted)
+			Changed.push_back(InternOutputName(pTypeDesc->fieldName));
+		Count += Deleted;
+	});
+
+	MarkEntityOutputsChanged(pEntity);
+	for(int OutputId : Changed)
+		NotifyOutputChanged(pEntity, OutputId, OutputChange_Removed);
+
+	return Count;
+}
+
+/**
+ * Batch forms of the per-entity natives. The output is resolved once and its
+ * offset once per distinct datamap, invalid entities and entities without the
+ * output get -1 in Results.
+ */
+struct BatchOutputResolver
+{
+	int OutputId;
+	const char *pOutput;
+	datamap_t *pLastMap = NULL;
+	int LastOffset = -1;
+
+	CBaseEntityOutput *Get(CBaseEntity *pEntity)
+	{
+		datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+		if(!pMap)
+			return NULL;
+
+		if(pMap != pLastMap)
+		{
+			pLastMap = pMap;
+
+			// A name no class had so far may still be an output of this one.
+			if(OutputId == -1)
+				OutputId = FindEntityOutputId(pEntity, pOutput);
+
+			LastOffset = OutputId == -1 ? -1 : GetOutputSlot(pMap, OutputId)->Offset;
+		}
+
+		return LastOffset == -1 ? NULL : (CBaseEntityOutput *)((intptr_t)pEntity + LastOffset);
+	}
+};
+
+// Reads the Entities, Count, output and Results arguments shared by the batch natives.
+bool ReadBatchParams(IPluginContext *pContext, const cell_t *params, bool ById, cell_t **ppEntities, int *pCount, BatchOutputResolver *pResolver, cell_t **ppResults)
+{
+	*pCount = params[2];
+	if(*pCount < 0)
+	{
+		pContext->ThrowNativeError("Invalid entity count %d", *pCount);
+		return false;
+	}
+
+	if(!GetOutputIdParam(pContext, params[3], ById, &pResolver->OutputId, &pResolver->pOutput))
+		return false;
+
+	pContext->LocalToPhysAddr(params[1], ppEntities);
+	pContext->LocalToPhysAddr(params[4], ppResults);
+	return true;
+}
+
+cell_t GetOutputCountBatchImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	cell_t *pEntities, *pResults;
+	int Count;
+	BatchOutputResolver Resolver;
+	if(!ReadBatchParams(pContext, params, ById, &pEntities, &Count, &Resolver, &pResults))
+		return 0;
+
+	int Found = 0;
+	for(int i = 0; i < Count; i++)
+	{
+		CBaseEntity *pEntity = GetEntityParam(pEntities[i]);
+		CBaseEntityOutput *pEntityOutput = pEntity ? Resolver.Get(pEntity) : NULL;
+		if(pEntityOutput == NULL)
+		{
+			pResults[i] = -1;
+			continue;
+		}
+
+		pResults[i] = pEntityOutput->NumberOfElements();
+		Found++;
+	}
+
+	return Found;
+}
+OUTPUT_NATIVE(GetOutputCountBatch)
+
+cell_t FindOutputBatchImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	cell_t *pEntities, *pResults;
+	int Count;
+	BatchOutputResolver Resolver;
+	if(!ReadBatchParams(pContext, params, ById, &pEntities, &Count, &Resolver, &pResults))
+		return 0;
+
+	ActionFilter Filter;
+	ReadActionFilterParams(pContext, params, 5, &Filter);
+
+	int Found = 0;
+	for(int i = 0; i < Count; i++)
+	{
+		pResults[i] = -1;
+
+		CBaseEntity *pEntity = GetEntityParam(pEntities[i]);
+		CBaseEntityOutput *pEntityOutput = pEntity ? Resolver.Get(pEntity) : NULL;
+		if(pEntityOutput == NULL)
+			continue;
+
+		int Index = 0;
+		for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext, Index++)
+		{
+			if(Filter.Matches(ev))
+			{
+				pResults[i] = Index;
+				Found++;
+				break;
+			}
+		}
+	}
+
+	return Found;
+}
+OUTPUT_NATIVE(FindOutputBatch)
+
+cell_t DeleteOutputsMatchingBatchImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	cell_t *pEntities, *pResults;
+	int Count;
+	BatchOutputResolver Resolver;
+	if(!ReadBatchParams(pContext, params, ById, &pEntities, &Count, &Resolver, &pResults))
+		return 0;
+
+	ActionFilter Filter;
+	ReadActionFilterParams(pContext, params, 5, &Filter);
+
+	int Total = 0;
+	for(int i = 0; i < Count; i++)
+	{
+		CBaseEntity *pEntity = GetEntityParam(pEntities[i]);
+		CBaseEntityOutput *pEntityOutput = pEntity ? Resolver.Get(pEntity) : NULL;
+		if(pEntityOutput == NULL)
+		{
+			pResults[i] = -1;
+			continue;
+		}
+
+		int Deleted = pEntityOutput->DeleteMatchingElements(Filter);
+		if(Deleted)
+		{
+			MarkEntityOutputsChanged(pEntity);
+			NotifyOutputChanged(pEntity, Resolver.OutputId, OutputChange_Removed);
+		}
+
+		pResults[i] = Deleted;
+		Total += Deleted;
+	}
+
+	return Total;
+}
+OUTPUT_NATIVE(DeleteOutputsMatchingBatch)
+
+cell_t CompactOutputActionsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	DuplicateActionFilter Filter;
+	int Count = pEntityOutput->DeleteMatchingElements(Filter);
+	if(Count)
+	{
+		MarkEntityOutputsChanged(pEntity);
+		NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+	}
+
+	return Count;
+}
+OUTPUT_NATIVE(CompactOutputActions)
+
+CON_COMMAND(sm_outputinfo_dedupe, "sm_outputinfo_dedupe - Remove exact duplicate actions from every output on the map")
+{
+	if(servertools == NULL)
+		return;
+
+	DuplicateActionFilter Filter;
+	int Actions = 0;
+	int Entities = 0;
+
+	for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+	{
+		int Count = 0;
+		std::vector<int> Changed;
+		ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+		{
+			// Nothing to compare on lists this short.
+			if(pEntityOutput->m_ActionList == NULL || pEntityOutput->m_ActionList->m_pNext == NULL)
+				return;
+
+			Filter.Seen.clear();
+			int Deleted = pEntityOutput->DeleteMatchingElements(Filter);
+			if(Deleted)
+				Changed.push_back(InternOutputName(pTypeDesc->fieldName));
+			Count += Deleted;
+		});
+
+		for(int OutputId : Changed)
+			NotifyOutputChanged(pEntity, OutputId, OutputChange_Removed);
+
+		if(Count)
+		{
+			MarkEntityOutputsChanged(pEntity);
+			Actions += Count;
+			Entities++;
+		}
+	}
+
+	META_CONPRINTF("[OutputInfo] Removed %d duplicate actions from %d entities.\n", Actions, Entities);
+}
+
+cell_t GetOutputActionsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	ICellArray *pArray = GetCellArrayParam(pContext, params[3], ACTION_CELLS);
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+
+	int Count = 0;
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		WriteOutputAction(pBlock, ev);
+		Count++;
+	}
+
+	return Count;
+}
+OUTPUT_NATIVE(GetOutputActions)
+
+OutputFilter *GetOutputFilterParam(IPluginContext *pContext, cell_t Param)
+{
+	Handle_t hndl = (Handle_t)Param;
+	HandleSecurity sec(pContext->GetIdentity(), myself->GetIdentity());
+
+	OutputFilter *pFilter;
+	HandleError err = handlesys->ReadHandle(hndl, g_OutputFilterType, &sec, (void **)&pFilter);
+	if(err != HandleError_None)
+	{
+		pContext->ThrowNativeError("Invalid OutputFilter handle %x (error %d)", hndl, err);
+		return NULL;
+	}
+
+	return pFilter;
+}
+
+cell_t OutputFilter_OutputFilter(IPluginContext *pContext, const cell_t *params)
+{
+	char *pTarget, *pTargetInput, *pParameter;
+	pContext->LocalToStringNULL(params[1], &pTarget);
+	pContext->LocalToStringNULL(params[2], &pTargetInput);
+	pContext->LocalToStringNULL(params[3], &pParameter);
+
+	OutputFilter *pFilter = new OutputFilter(pTarget, pTargetInput, pParameter, sp_ctof(params[4]), params[5], params[6]);
+
+	HandleError err;
+	Handle_t hndl = handlesys->CreateHandle(g_OutputFilterType, pFilter, pContext->GetIdentity(), myself->GetIdentity(), &err);
+	if(hndl == BAD_HANDLE)
+	{
+		delete pFilter;
+		return pContext->ThrowNativeError("Failed to create OutputFilter handle (error %d)", err);
+	}
+
+	return hndl;
+}
+
+cell_t FindOutputFilteredImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	OutputFilter *pFilter = GetOutputFilterParam(pContext, params[4]);
+	if(pFilter == NULL)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	int Index = 0;
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext, Index++)
+	{
+		if(Index >= params[3] && pFilter->Matches(ev))
+			return Index;
+	}
+
+	return -1;
+}
+OUTPUT_NATIVE(FindOutputFiltered)
+
+cell_t DeleteOutputsFilteredImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	OutputFilter *pFilter = GetOutputFilterParam(pContext, params[3]);
+	if(pFilter == NULL)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	int Count = pEntityOutput->DeleteMatchingElements(*pFilter);
+	if(Count)
+	{
+		MarkEntityOutputsChanged(pEntity);
+		NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+	}
+
+	return Count;
+}
+OUTPUT_NATIVE(DeleteOutputsFiltered)
+
+cell_t DeleteEntityOutputsFiltered(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	OutputFilter *pFilter = GetOutputFilterParam(pContext, params[2]);
+	if(pFilter == NULL)
+		return -1;
+
+	int Count = 0;
+	std::vector<int> Changed;
+	ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+	{
+		int Deleted = pEntityOutput->DeleteMatchingElements(*pFilter);
+		if(Deleted)
+			Changed.push_back(InternOutputName(pTypeDesc->fieldName));
+		Count += Deleted;
+	});
+
+	MarkEntityOutputsChanged(pEntity);
+	for(int OutputId : Changed)
+		NotifyOutputChanged(pEntity, OutputId, OutputChange_Removed);
+
+	return Count;
+}
+
+cell_t InsertOutputActionImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	if(!CEventAction::CanCreate())
+		return ThrowCreateActionError(pContext);
+
+	char *pTarget, *pTargetInput, *pParameter;
+	pContext->LocalToString(params[4], &pTarget);
+	pContext->LocalToString(params[5], &pTargetInput);
+	pContext->LocalToString(params[6], &pParameter);
+
+	CEventAction *pAction = CEventAction::Create(AllocOutputString(pTarget), AllocOutputString(pTargetInput),
+		AllocOutputString(pParameter), sp_ctof(params[7]), params[8]);
+	if(pAction == NULL)
+		return pContext->ThrowNativeError("Failed to allocate CEventAction");
+
+	pEntityOutput->InsertElement(params[3], pAction);
+	MarkEntityOutputsChanged(pEntity);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Added);
+
+	return pAction->m_iIDStamp;
+}
+OUTPUT_NATIVE(InsertOutputAction)
+
+/**
+ * Copies or moves every action of pFrom onto the end of pTo, replacing pTo's
+ * own actions unless bAppend. Copies share the source's pooled strings, moved
+ * actions are relinked as they are. Returns the number of actions transferred,
+ * or -1 without touching either output if a copy couldn't be allocated.
+ */
+int TransferActions(CBaseEntityOutput *pFrom, CBaseEntityOutput *pTo, bool bMove, bool bAppend)
+{
+	if(bMove && pFrom == pTo)
+		return 0;
+
+	// Build the chain first, copying an output onto itself must not see its own copies.
+	int Count = 0;
+	CEventAction *pHead = NULL;
+	if(bMove)
+	{
+		pHead = pFrom->m_ActionList;
+		pFrom->m_ActionList = NULL;
+		for(CEventAction *ev = pHead; ev != NULL; ev = ev->m_pNext)
+			Count++;
+	}
+	else
+	{
+		CEventAction **ppTail = &pHead;
+		for(CEventAction *ev = pFrom->m_ActionList; ev != NULL; ev = ev->m_pNext)
+		{
+			CEventAction *pCopy = CEventAction::Create(ev->m_iTarget, ev->m_iTargetInput, ev->m_iParameter, ev->m_flDelay, ev->m_nTimesToFire);
+			if(pCopy == NULL)
+			{
+				// Leave the target alone rather than give it half the copies.
+				while(pHead != NULL)
+				{
+					CEventAction *pStrikeThis = pHead;
+					pHead = pHead->m_pNext;
+					delete pStrikeThis;
+				}
+				return -1;
+			}
+
+			*ppTail = pCopy;
+			ppTail = &pCopy->m_pNext;
+			Count++;
+		}
+	}
+
+	if(!bAppend)
+		pTo->DeleteAllElements();
+
+	CEventAction **ppLink = &pTo->m_ActionList;
+	while(*ppLink != NULL)
+		ppLink = &(*ppLink)->m_pNext;
+	*ppLink = pHead;
+
+	g_OutputListEpoch++;
+	return Count;
+}
+
+cell_t TransferOutputsImpl(IPluginContext *pContext, const cell_t *params, bool ById, bool bMove)
+{
+	CBaseEntity *pFrom = GetEntityParam(params[1]);
+	CBaseEntity *pTo = GetEntityParam(params[2]);
+	if(!pFrom || !pTo)
+		return -1;
+
+	if(!bMove && !CEventAction::CanCreate())
+		return ThrowCreateActionError(pContext);
+
+	int OutputId = -1;
+	if(ById)
+	{
+		OutputId = params[3];
+		if(OutputId != -1 && !IsValidOutputId(OutputId))
+			return pContext->ThrowNativeError("Invalid output id %d", OutputId);
+	}
+	else
+	{
+		char *pOutput;
+		pContext->LocalToString(params[3], &pOutput);
+		if(pOutput[0] && strcmp(pOutput, "*"))
+		{
+			OutputId = FindEntityOutputId(pFrom, pOutput);
+			if(OutputId == -1)
+				return -1;
+		}
+	}
+
+	bool bAppend = params[4] != 0;
+	bool bFailed = false;
+	int Count = 0;
+	std::vector<int> Changed;
+	std::vector<int> Cleared; // replaced by an empty source, nothing was added
+
+	auto Transfer = [&](int Id, CBaseEntityOutput *pFromOutput) -> bool
+	{
+		CBaseEntityOutput *pToOutput = GetOutput(pTo, Id);
+		if(pToOutput == NULL)
+			return false;
+
+		if(pFromOutput->m_ActionList == NULL)
+		{
+			if(bAppend || pToOutput->m_ActionList == NULL)
+				return true;
+
+			pToOutput->DeleteAllElements();
+			Cleared.push_back(Id);
+			return true;
+		}
+
+		int Transferred = TransferActions(pFromOutput, pToOutput, bMove, bAppend);
+		if(Transferred == -1)
+		{
+			bFailed = true;
+			return false;
+		}
+
+		Count += Transferred;
+		Changed.push_back(Id);
+		return true;
+	};
+
+	if(OutputId != -1)
+	{
+		CBaseEntityOutput *pFromOutput = GetOutput(pFrom, OutputId);
+		if(pFromOutput == NULL || (!Transfer(OutputId, pFromOutput) && !bFailed))
+			return -1;
+	}
+	else
+	{
+		// Outputs the target entity doesn't have are skipped.
+		ForEachEntityOutput(pFrom, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pFromOutput)
+		{
+			if(!bFailed)
+				Transfer(InternOutputName(pTypeDesc->fieldName), pFromOutput);
+		});
+	}
+
+	if(!Changed.empty() || !Cleared.empty())
+	{
+		MarkEntityOutputsChanged(pTo);
+		if(bMove && !Changed.empty())
+			MarkEntityOutputsChanged(pFrom);
+
+		for(int Id : Changed)
+		{
+			if(bMove)
+				NotifyOutputChanged(pFrom, Id, OutputChange_Removed);
+			NotifyOutputChanged(pTo, Id, OutputChange_Added);
+		}
+
+		for(int Id : Cleared)
+			NotifyOutputChanged(pTo, Id, OutputChange_Removed);
+	}
+
+	// Outputs handled before the pool ran dry keep their copies.
+	if(bFailed)
+		return ThrowCreateActionError(pContext);
+
+	return Count;
+}
+
+cell_t CopyOutputsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	return TransferOutputsImpl(pContext, params, ById, false);
+}
+OUTPUT_NATIVE(CopyOutputs)
+
+cell_t MoveOutputsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	return TransferOutputsImpl(pContext, params, ById, true);
+}
+OUTPUT_NATIVE(MoveOutputs)
+
+/**
+ * Resolves the entity, output and action index arguments of the SetOutput* natives.
+ */
+CEventAction *GetActionParams(IPluginContext *pContext, const cell_t *params, bool ById, CBaseEntity **ppEntity, CBaseEntityOutput **ppEntityOutput)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return NULL;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return NULL;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(pAction)
+		MarkEntityOutputsChanged(pEntity);
+
+	*ppEntity = pEntity;
+	*ppEntityOutput = pEntityOutput;
+	return pAction;
+}
+
+cell_t SetOutputTargetImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity;
+	CBaseEntityOutput *pEntityOutput;
+	CEventAction *pAction = GetActionParams(pContext, params, ById, &pEntity, &pEntityOutput);
+	if(!pAction)
+		return 0;
+
+	char *pTarget;
+	pContext->LocalToString(params[4], &pTarget);
+	pAction->m_iTarget = AllocOutputString(pTarget);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Modified);
+
+	return 1;
+}
+OUTPUT_NATIVE(SetOutputTarget)
+
+cell_t SetOutputTargetInputImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity;
+	CBaseEntityOutput *pEntityOutput;
+	CEventAction *pAction = GetActionParams(pContext, params, ById, &pEntity, &pEntityOutput);
+	if(!pAction)
+		return 0;
+
+	char *pTargetInput;
+	pContext->LocalToString(params[4], &pTargetInput);
+	pAction->m_iTargetInput = AllocOutputString(pTargetInput);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Modified);
+
+	return 1;
+}
+OUTPUT_NATIVE(SetOutputTargetInput)
+
+cell_t SetOutputParameterImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity;
+	CBaseEntityOutput *pEntityOutput;
+	CEventAction *pAction = GetActionParams(pContext, params, ById, &pEntity, &pEntityOutput);
+	if(!pAction)
+		return 0;
+
+	char *pParameter;
+	pContext->LocalToString(params[4], &pParameter);
+	pAction->m_iParameter = AllocOutputString(pParameter);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Modified);
+
+	return 1;
+}
+OUTPUT_NATIVE(SetOutputParameter)
+
+cell_t SetOutputDelayImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity;
+	CBaseEntityOutput *pEntityOutput;
+	CEventAction *pAction = GetActionParams(pContext, params, ById, &pEntity, &pEntityOutput);
+	if(!pAction)
+		return 0;
+
+	pAction->m_flDelay = sp_ctof(params[4]);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Modified);
+
+	return 1;
+}
+OUTPUT_NATIVE(SetOutputDelay)
+
+cell_t SetOutputTimesToFireImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity;
+	CBaseEntityOutput *pEntityOutput;
+	CEventAction *pAction = GetActionParams(pContext, params, ById, &pEntity, &pEntityOutput);
+	if(!pAction)
+		return 0;
+
+	pAction->m_nTimesToFire = params[4];
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Modified);
+
+	return 1;
+}
+OUTPUT_NATIVE(SetOutputTimesToFire)
+
+cell_t GetOutputNames(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return -1;
+
+	const std::vector<OutputDesc> &Outputs = GetDataMapOutputs(pMap);
+	if(params[2] < 0 || params[2] >= (cell_t)Outputs.size())
+		return -1;
+
+	size_t len;
+	pContext->StringToLocalUTF8(params[3], params[4], Outputs[params[2]].pTypeDesc->fieldName, &len);
+	return len;
+}
+
+cell_t GetOutputNameCount(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return -1;
+
+	return GetDataMapOutputs(pMap).size();
+}
+
+/**
+ * Cell layout of enum struct EntityOutput in outputinfo.inc.
+ */
+#define ENTITYOUTPUT_NAME			0	// char[64]
+#define ENTITYOUTPUT_OUTPUTID		16
+#define ENTITYOUTPUT_FIRSTACTION	17
+#define ENTITYOUTPUT_ACTIONS		18
+#define ENTITYOUTPUT_CELLS			19
+
+cell_t GetEntityOutputs(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
+		return -1;
+
+	if(params[2] == params[3])
+		return pContext->ThrowNativeError("Outputs and Actions have to be different ArrayLists");
+
+	ICellArray *pOutputs = GetCellArrayParam(pContext, params[2], ENTITYOUTPUT_CELLS);
+	if(pOutputs == NULL)
+		return -1;
+
+	ICellArray *pActions = GetCellArrayParam(pContext, params[3], ACTION_CELLS);
+	if(pActions == NULL)
+		return -1;
+
+	pOutputs->clear();
+	pActions->clear();
+
+	const std::vector<OutputDesc> &Outputs = GetDataMapOutputs(pMap);
+	for(const OutputDesc &Desc : Outputs)
+	{
+		cell_t *pBlock = pOutputs->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		ke::SafeStrcpy((char *)&pBlock[ENTITYOUTPUT_NAME], (ENTITYOUTPUT_OUTPUTID - ENTITYOUTPUT_NAME) * sizeof(cell_t), Desc.pTypeDesc->fieldName);
+		pBlock[ENTITYOUTPUT_OUTPUTID] = Desc.OutputId;
+		pBlock[ENTITYOUTPUT_FIRSTACTION] = (cell_t)pActions->size();
+
+		int Count = 0;
+		CBaseEntityOutput *pEntityOutput = (CBaseEntityOutput *)((intptr_t)pEntity + Desc.Offset);
+		for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+		{
+			cell_t *pAction = pActions->push();
+			if(pAction == NULL)
+				return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+			WriteOutputAction(pAction, ev);
+			Count++;
+		}
+
+		pBlock[ENTITYOUTPUT_ACTIONS] = Count;
+	}
+
+	return Outputs.size();
+}
+
+bool IsOutputLinkCurrent(const OutputLink &Link)
+{
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(Link.EntityRef);
+	if(!pEntity)
+		return false;
+
+	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, Link.OutputId);
+	if(pEntityOutput == NULL)
+		return false;
+
+	CEventAction *ev = pEntityOutput->m_ActionList;
+	for(int Index = 0; ev != NULL && Index < Link.Index; Index++)
+		ev = ev->m_pNext;
+
+	return ev != NULL && ev == Link.pAction && ev->m_iIDStamp == Link.IDStamp;
+}
+
+cell_t FindOutputsTargeting(IPluginContext *pContext, const cell_t *params)
+{
+	char *pTarget;
+	pContext->LocalToString(params[1], &pTarget);
+
+	ICellArray *pArray = GetCellArrayParam(pContext, params[2], 3);
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+	FlushTargetIndex();
+
+	std::string Key = GetTargetKey(pTarget);
+	std::vector<const std::vector<OutputLink> *> Buckets;
+	auto CollectBuckets = [&]()
+	{
+		Buckets.clear();
+
+		auto Bucket = g_TargetIndex.find(Key);
+		if(Bucket != g_TargetIndex.end())
+			Buckets.push_back(&Bucket->second);
+
+		// Actions targeting "name*..." hit every entity whose name starts with "name".
+		for(const std::string &Wildcard : g_WildcardTargets)
+		{
+			if(Wildcard == Key || Key.compare(0, Wildcard.size() - 1, Wildcard, 0, Wildcard.size() - 1) != 0)
+				continue;
+
+			Buckets.push_back(&g_TargetIndex[Wildcard]);
+		}
+	};
+	CollectBuckets();
+
+	// Consumed actions shift the ones behind them, and go unseen while the
+	// FireOutput detour is off. Reindex the entities whose links moved.
+	bool bStale = false;
+	for(const std::vector<OutputLink> *pLinks : Buckets)
+	{
+		for(const OutputLink &Link : *pLinks)
+		{
+			if(!IsOutputLinkCurrent(Link))
+			{
+				g_DirtyEntities.insert(Link.EntityRef);
+				bStale = true;
+			}
+		}
+	}
+
+	if(bStale)
+	{
+		FlushTargetIndex();
+		CollectBuckets();
+	}
+
+	int Count = 0;
+	for(const std::vector<OutputLink> *pLinks : Buckets)
+	{
+		for(const OutputLink &Link : *pLinks)
+		{
+			cell_t *pBlock = pArray->push();
+			if(pBlock == NULL)
+				return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+			pBlock[0] = gamehelpers->ReferenceToBCompatRef(Link.EntityRef);
+			pBlock[1] = Link.OutputId;
+			pBlock[2] = Link.Index;
+			Count++;
+		}
+	}
+
+	return Count;
+}
+
+cell_t ResolveOutputTargetsImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return -1;
+
+	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
+	if(pAction == NULL)
+		return -1;
+
+	ICellArray *pArray = GetCellArrayParam(pContext, params[4], 1);
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+
+	bool bFailed = false;
+	int Count = ForEachOutputTarget(pEntity, pAction->m_iTarget.ToCStr(), [&](cell_t EntityRef)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+		{
+			bFailed = true;
+			return;
+		}
+
+		pBlock[0] = gamehelpers->ReferenceToBCompatRef(EntityRef);
+	});
+
+	if(bFailed)
+		return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+	return Count;
+}
+OUTPUT_NATIVE(ResolveOutputTargets)
+
+cell_t GetOutputIdName(IPluginContext *pContext, const cell_t *params)
+{
+	if(!IsValidOutputId(params[1]))
+		return pContext->ThrowNativeError("Invalid output id %d", params[1]);
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[2], params[3], OutputIdToName(params[1]), &Length);
+
+	return Length;
+}
+
+/**
+ * Cursor over an action list. It sits either on an action (pCurrent) or in
+ * the gap after pPrev, which is where it ends up after DeleteCurrent.
+ */
+struct OutputIterator
+{
+	cell_t EntityRef;
+	int OutputId;
+	CEventAction *pPrev;
+	CEventAction *pCurrent;
+	int PrevIndex; // -1 if pPrev is the list head
+	unsigned int Epoch;
+};
+
+/**
+ * Returns the output the iterator walks, re-finding its position by pointer
+ * if the list may have changed since the last step. Returns NULL if the
+ * entity is gone or the position can't be recovered, which ends the walk.
+ */
+CBaseEntityOutput *ValidateOutputIterator(OutputIterator *pIterator)
+{
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(pIterator->EntityRef);
+	if(!pEntity)
+		return NULL;
+
+	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pIterator->OutputId);
+	if(pEntityOutput == NULL)
+		return NULL;
+
+	// The epoch only covers engine side removals while the FireOutput detour
+	// sees them, otherwise the saved pointers are rechecked on every step.
+	if(pIterator->Epoch == g_OutputListEpoch && g_pFireOutputDetour && g_pFireOutputDetour->IsEnabled())
+		return pEntityOutput;
+
+	// The saved pointers may be freed, only compare them, never dereference.
+	bool FoundPrev = pIterator->pPrev == NULL;
+	bool FoundCurrent = pIterator->pCurrent == NULL;
+	CEventAction *pPrev = NULL;
+	int Index = 0;
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext, Index++)
+	{
+		if(ev == pIterator->pCurrent)
+		{
+			pIterator->pPrev = pPrev;
+			pIterator->PrevIndex = Index - 1;
+			FoundPrev = FoundCurrent = true;
+			break;
+		}
+
+		if(ev == pIterator->pPrev)
+		{
+			pIterator->PrevIndex = Index;
+			FoundPrev = true;
+			if(pIterator->pCurrent == NULL)
+				break;
+		}
+
+		pPrev = ev;
+	}
+
+	if(!FoundPrev)
+		return NULL;
+
+	if(!FoundCurrent)
+		pIterator->pCurrent = NULL;
+
+	pIterator->Epoch = g_OutputListEpoch;
+	return pEntityOutput;
+}
+
+OutputIterator *GetOutputIteratorParam(IPluginContext *pContext, cell_t Param)
+{
+	Handle_t hndl = (Handle_t)Param;
+	HandleSecurity sec(pContext->GetIdentity(), myself->GetIdentity());
+
+	OutputIterator *pIterator;
+	HandleError err = handlesys->ReadHandle(hndl, g_OutputIteratorType, &sec, (void **)&pIterator);
+	if(err != HandleError_None)
+	{
+		pContext->ThrowNativeError("Invalid OutputIterator handle %x (error %d)", hndl, err);
+		return NULL;
+	}
+
+	return pIterator;
+}
+
+CEventAction *GetOutputIteratorAction(IPluginContext *pContext, cell_t Param)
+{
+	OutputIterator *pIterator = GetOutputIteratorParam(pContext, Param);
+	if(pIterator == NULL)
+		return NULL;
+
+	if(ValidateOutputIterator(pIterator) == NULL || pIterator->pCurrent == NULL)
+	{
+		pContext->ThrowNativeError("OutputIterator is not positioned on an action");
+		return NULL;
+	}
+
+	return pIterator->pCurrent;
+}
+
+cell_t OutputIterator_OutputIteratorImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return BAD_HANDLE;
+
+	const char *pOutput;
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById, &pOutput);
+	if(pEntityOutput == NULL)
+		return BAD_HANDLE;
+
+	OutputIterator *pIterator = new OutputIterator;
+	pIterator->EntityRef = gamehelpers->EntityToReference(pEntity);
+	pIterator->OutputId = InternOutputName(pOutput);
+	pIterator->pPrev = NULL;
+	pIterator->pCurrent = NULL;
+	pIterator->PrevIndex = -1;
+	pIterator->Epoch = g_OutputListEpoch;
+
+	HandleError err;
+	Handle_t hndl = handlesys->CreateHandle(g_OutputIteratorType, pIterator, pContext->GetIdentity(), myself->GetIdentity(), &err);
+	if(hndl == BAD_HANDLE)
+	{
+		delete pIterator;
+		return pContext->ThrowNativeError("Failed to create OutputIterator handle (error %d)", err);
+	}
+
+	return hndl;
+}
+OUTPUT_NATIVE(OutputIterator_OutputIterator)
+
+cell_t OutputIterator_Next(IPluginContext *pContext, const cell_t *params)
+{
+	OutputIterator *pIterator = GetOutputIteratorParam(pContext, params[1]);
+	if(pIterator == NULL)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = ValidateOutputIterator(pIterator);
+	if(pEntityOutput == NULL)
+		return 0;
+
+	if(pIterator->pCurrent != NULL)
+	{
+		pIterator->pPrev = pIterator->pCurrent;
+		pIterator->PrevIndex++;
+	}
+
+	pIterator->pCurrent = pIterator->pPrev ? pIterator->pPrev->m_pNext : pEntityOutput->m_ActionList;
+	return pIterator->pCurrent != NULL;
+}
+
+cell_t OutputIterator_Reset(IPluginContext *pContext, const cell_t *params)
+{
+	OutputIterator *pIterator = GetOutputIteratorParam(pContext, params[1]);
+	if(pIterator == NULL)
+		return 0;
+
+	pIterator->pPrev = NULL;
+	pIterator->pCurrent = NULL;
+	pIterator->PrevIndex = -1;
+	pIterator->Epoch = g_OutputListEpoch;
+
+	return 0;
+}
+
+cell_t OutputIterator_DeleteCurrent(IPluginContext *pContext, const cell_t *params)
+{
+	OutputIterator *pIterator = GetOutputIteratorParam(pContext, params[1]);
+	if(pIterator == NULL)
+		return 0;
+
+	CBaseEntityOutput *pEntityOutput = ValidateOutputIterator(pIterator);
+	if(pEntityOutput == NULL || pIterator->pCurrent == NULL)
+		return 0;
+
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(pIterator->EntityRef);
+	pEntityOutput->RemoveElement(pIterator->pPrev, pIterator->pCurrent);
+	pIterator->pCurrent = NULL;
+	pIterator->Epoch = g_OutputListEpoch;
+
+	MarkEntityOutputsChanged(pEntity);
+	NotifyOutputChanged(pEntity, pEntityOutput, OutputChange_Removed);
+
+	return 1;
+}
+
+cell_t OutputIterator_IndexGet(IPluginContext *pContext, const cell_t *params)
+{
+	OutputIterator *pIterator = GetOutputIteratorParam(pContext, params[1]);
+	if(pIterator == NULL)
+		return -1;
+
+	if(ValidateOutputIterator(pIterator) == NULL || pIterator->pCurrent == NULL)
+		return -1;
+
+	return pIterator->PrevIndex + 1;
+}
+
+cell_t OutputIterator_GetTarget(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[2], params[3], pAction->m_iTarget.ToCStr(), &Length);
+
+	return Length;
+}
+
+cell_t OutputIterator_GetTargetInput(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[2], params[3], pAction->m_iTargetInput.ToCStr(), &Length);
+
+	return Length;
+}
+
+cell_t OutputIterator_GetParameter(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	size_t Length;
+	pContext->StringToLocalUTF8(params[2], params[3], pAction->m_iParameter.ToCStr(), &Length);
+
+	return Length;
+}
+
+cell_t OutputIterator_DelayGet(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	return sp_ftoc(pAction->m_flDelay);
+}
+
+cell_t OutputIterator_TimesToFireGet(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	return pAction->m_nTimesToFire;
+}
+
+cell_t OutputIterator_IDStampGet(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	return pAction->m_iIDStamp;
+}
+
+cell_t OutputIterator_GetAction(IPluginContext *pContext, const cell_t *params)
+{
+	CEventAction *pAction = GetOutputIteratorAction(pContext, params[1]);
+	if(!pAction)
+		return 0;
+
+	cell_t *pBlock;
+	pContext->LocalToPhysAddr(params[2], &pBlock);
+	WriteOutputAction(pBlock, pAction);
+
+	return 1;
+}
+
+/**
+ * Event queue introspection. Every fired action ends up as an event in the
+ * game's global g_EventQueue until its delay has passed.
+ */
+inline CBaseEntity *HandleToEntity(const CBaseHandle &Handle)
+{
+	if(!Handle.IsValid())
+		return NULL;
+
+	// Entity references are handles with the high bit set.
+	return gamehelpers->ReferenceToEntity((cell_t)(Handle.ToInt() | (1<<31)));
+}
+
+inline cell_t HandleToBCompatRef(const CBaseHandle &Handle)
+{
+	CBaseEntity *pEntity = HandleToEntity(Handle);
+	return pEntity ? gamehelpers->EntityToBCompatRef(pEntity) : -1;
+}
+
+const char *FormatVariant(const varianthax_t &Value, char *pBuffer, size_t Size)
+{
+	switch(Value.fieldType)
+	{
+	case FIELD_STRING:
+	case FIELD_MODELNAME:
+	case FIELD_SOUNDNAME:
+		return Value.iszVal.ToCStr();
+	case FIELD_INTEGER:
+	case FIELD_TICK:
+	case FIELD_SHORT:
+	case FIELD_CHARACTER:
+	case FIELD_MODELINDEX:
+	case FIELD_MATERIALINDEX:
+		ke::SafeSprintf(pBuffer, Size, "%d", Value.iVal);
+		break;
+	case FIELD_BOOLEAN:
+		ke::SafeSprintf(pBuffer, Size, "%d", Value.bVal ? 1 : 0);
+		break;
+	case FIELD_FLOAT:
+	case FIELD_TIME:
+		ke::SafeSprintf(pBuffer, Size, "%g", Value.flVal);
+		break;
+	case FIELD_VECTOR:
+	case FIELD_POSITION_VECTOR:
+		ke::SafeSprintf(pBuffer, Size, "%g %g %g", Value.vecVal[0], Value.vecVal[1], Value.vecVal[2]);
+		break;
+	case FIELD_COLOR32:
+		ke::SafeSprintf(pBuffer, Size, "%d %d %d %d", Value.rgbaVal.r, Value.rgbaVal.g, Value.rgbaVal.b, Value.rgbaVal.a);
+		break;
+	case FIELD_EHANDLE:
+		ke::SafeSprintf(pBuffer, Size, "%d", HandleToBCompatRef(Value.eVal));
+		break;
+	default:
+		pBuffer[0] = '\0';
+		break;
+	}
+
+	return pBuffer;
+}
+
+/**
+ * Cell layout of enum struct QueuedEvent in outputinfo.inc.
+ */
+#define EVENT_TARGET			0	// char[64]
+#define EVENT_TARGETINPUT		16	// char[64]
+#define EVENT_PARAMETER			32	// char[256]
+#define EVENT_FIRETIME			96
+#define EVENT_ACTIVATOR			97
+#define EVENT_CALLER			98
+#define EVENT_OUTPUTID			99
+#define EVENT_TARGETENTITY		100
+#define EVENT_CELLS				101
+
+cell_t GetEventQueueCount(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pEventQueue)
+		return pContext->ThrowNativeError("g_EventQueue is not available on this game/platform");
+
+	return g_pEventQueue->m_iListCount;
+}
+
+cell_t GetEventQueueEvents(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pEventQueue)
+		return pContext->ThrowNativeError("g_EventQueue is not available on this game/platform");
+
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], EVENT_CELLS);
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+
+	int Count = 0;
+	for(EventQueuePrioritizedEvent_t *pe = g_pEventQueue->m_Events.m_pNext; pe != NULL; pe = pe->m_pNext)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		char aParameter[256];
+		ke::SafeStrcpy((char *)&pBlock[EVENT_TARGET], (EVENT_TARGETINPUT - EVENT_TARGET) * sizeof(cell_t), pe->m_iTarget.ToCStr());
+		ke::SafeStrcpy((char *)&pBlock[EVENT_TARGETINPUT], (EVENT_PARAMETER - EVENT_TARGETINPUT) * sizeof(cell_t), pe->m_iTargetInput.ToCStr());
+		ke::SafeStrcpy((char *)&pBlock[EVENT_PARAMETER], (EVENT_FIRETIME - EVENT_PARAMETER) * sizeof(cell_t),
+			FormatVariant(pe->m_VariantValue, aParameter, sizeof(aParameter)));
+		pBlock[EVENT_FIRETIME] = sp_ftoc(pe->m_flFireTime);
+		pBlock[EVENT_ACTIVATOR] = HandleToBCompatRef(pe->m_pActivator);
+		pBlock[EVENT_CALLER] = HandleToBCompatRef(pe->m_pCaller);
+		pBlock[EVENT_OUTPUTID] = pe->m_iOutputID;
+		pBlock[EVENT_TARGETENTITY] = HandleToBCompatRef(pe->m_pEntTarget);
+		Count++;
+	}
+
+	return Count;
+}
+
+struct CancelByTarget
+{
+	const char *pTarget;
+	const char *pTargetInput;
+};
+
+cell_t CancelEventsByTarget(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pEventQueue || !EventQueuePrioritizedEvent_t::s_pOperatorDeleteFunc)
+		return pContext->ThrowNativeError("g_EventQueue is not available on this game/platform");
+
+	CancelByTarget Data;
+	char *pString;
+	pContext->LocalToString(params[1], &pString);
+	Data.pTarget = pString;
+	pContext->LocalToStringNULL(params[2], &pString);
+	Data.pTargetInput = pString;
+
+	// Target names are matched case-insensitively, like the engine does.
+	return g_pEventQueue->CancelMatching([](EventQueuePrioritizedEvent_t *pe, void *pData)
+	{
+		CancelByTarget *p = (CancelByTarget *)pData;
+		if(V_stricmp(pe->m_iTarget.ToCStr(), p->pTarget) != 0)
+			return false;
+
+		return p->pTargetInput == NULL || V_stricmp(pe->m_iTargetInput.ToCStr(), p->pTargetInput) == 0;
+	}, &Data);
+}
+
+cell_t CancelEventsByCaller(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pEventQueue || !EventQueuePrioritizedEvent_t::s_pOperatorDeleteFunc)
+		return pContext->ThrowNativeError("g_EventQueue is not available on this game/platform");
+
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return -1;
+
+	return g_pEventQueue->CancelMatching([](EventQueuePrioritizedEvent_t *pe, void *pData)
+	{
+		return HandleToEntity(pe->m_pCaller) == (CBaseEntity *)pData;
+	}, pEntity);
+}
+
+cell_t CancelEventsFiltered(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pEventQueue || !EventQueuePrioritizedEvent_t::s_pOperatorDeleteFunc)
+		return pContext->ThrowNativeError("g_EventQueue is not available on this game/platform");
+
+	OutputFilter *pFilter = GetOutputFilterParam(pContext, params[1]);
+	if(pFilter == NULL)
+		return -1;
+
+	return g_pEventQueue->CancelMatching([](EventQueuePrioritizedEvent_t *pe, void *pData)
+	{
+		char aParameter[256];
+		return ((OutputFilter *)pData)->MatchesEvent(pe->m_iTarget, pe->m_iTargetInput,
+			FormatVariant(pe->m_VariantValue, aParameter, sizeof(aParameter)));
+	}, pFilter);
+}
+
+/**
+ * FireOutput tracing. The detour is only enabled while something needs it,
+ * so the fire path is untouched when all features are off.
+ */
+struct OutputTraceEntry
+{
+	int Tick;
+	cell_t Entity;
+	int OutputId;
+	cell_t Activator;
+	cell_t Caller;
+	int Actions;
+};
+
+// Only ever touched from the game thread: the fire path appends at Head,
+// draining advances Tail, and the oldest entries are overwritten on overflow.
+#define OUTPUT_TRACE_SIZE 4096
+
+OutputTraceEntry g_aOutputTrace[OUTPUT_TRACE_SIZE];
+unsigned int g_OutputTraceHead = 0;
+unsigned int g_OutputTraceTail = 0;
+bool g_bOutputTraceEnabled = false;
+
+inline cell_t EntityToTraceRef(CBaseEntity *pEntity)
+{
+	return pEntity ? gamehelpers->EntityToBCompatRef(pEntity) : -1;
+}
+
+void RecordOutputTrace(CBaseEntity *pActivator, CBaseEntity *pCaller, int OutputId, int Actions)
+{
+	OutputTraceEntry &Entry = g_aOutputTrace[g_OutputTraceHead++ % OUTPUT_TRACE_SIZE];
+	Entry.Tick = gpGlobals->tickcount;
+	Entry.Entity = OutputId != -1 ? EntityToTraceRef(pCaller) : -1;
+	Entry.OutputId = OutputId;
+	Entry.Activator = EntityToTraceRef(pActivator);
+	Entry.Caller = EntityToTraceRef(pCaller);
+	Entry.Actions = Actions;
+
+	if(g_OutputTraceHead - g_OutputTraceTail > OUTPUT_TRACE_SIZE)
+		g_OutputTraceTail = g_OutputTraceHead - OUTPUT_TRACE_SIZE;
+}
+
+/**
+ * FireOutput profiler, accumulating per (classname, output) and per
+ * (entity, output). Both tables are preallocated open addressing tables so
+ * the fire path never allocates; once full, new keys are counted as dropped.
+ */
+struct ProfileStats
+{
+	uint64_t Fires;
+	uint64_t Actions;
+	uint64_t Nanoseconds;
+};
+
+template <size_t SIZE>
+class ProfileTable
+{
+public:
+	struct Entry
+	{
+		uintptr_t Owner; // classname string or entity reference
+		int OutputId;
+		bool bUsed;
+		char aClassname[64];
+		ProfileStats Stats;
+	};
+
+	ProfileStats *FindOrInsert(uintptr_t Owner, int OutputId, const char *pClassname)
+	{
+		size_t Slot = Hash(Owner, OutputId);
+		for(size_t Probe = 0; Probe < SIZE; Probe++, Slot = (Slot + 1) & (SIZE - 1))
+		{
+			Entry &e = m_aEntries[Slot];
+			if(e.bUsed)
+			{
+				if(e.Owner == Owner && e.OutputId == OutputId)
+					return &e.Stats;
+				continue;
+			}
+
+			// Keep the table at most 3/4 full so probes stay short.
+			if(m_Used >= SIZE / 4 * 3)
+				break;
+
+			e.bUsed = true;
+			e.Owner = Owner;
+			e.OutputId = OutputId;
+			ke::SafeStrcpy(e.aClassname, sizeof(e.aClassname), pClassname);
+			memset(&e.Stats, 0, sizeof(e.Stats));
+			m_Used++;
+			return &e.Stats;
+		}
+
+		m_Dropped++;
+		return NULL;
+	}
+
+	void Clear()
+	{
+		for(size_t i = 0; i < SIZE; i++)
+			m_aEntries[i].bUsed = false;
+
+		m_Used = 0;
+		m_Dropped = 0;
+	}
+
+	const Entry &At(size_t Slot) const { return m_aEntries[Slot]; }
+	size_t Capacity() const { return SIZE; }
+	size_t Used() const { return m_Used; }
+	uint64_t Dropped() const { return m_Dropped; }
+
+private:
+	static size_t Hash(uintptr_t Owner, int OutputId)
+	{
+		return (size_t)(((Owner >> 2) * 2654435761u) ^ ((unsigned int)OutputId * 40503u)) & (SIZE - 1);
+	}
+
+	Entry m_aEntries[SIZE];
+	size_t m_Used = 0;
+	uint64_t m_Dropped = 0;
+};
+
+ProfileTable<4096> g_ClassProfile;
+ProfileTable<8192> g_EntityProfile;
+bool g_bOutputProfileEnabled = false;
+
+void RecordOutputProfile(CBaseEntity *pCaller, int OutputId, int Actions, uint64_t Nanoseconds)
+{
+	const char *pClassname = pCaller ? gamehelpers->GetEntityClassname(pCaller) : NULL;
+	if(!pClassname)
+		pClassname = "";
+
+	// Pooled classnames share one pointer per distinct string while the map runs.
+	ProfileStats *pStats[2] = {
+		g_ClassProfile.FindOrInsert((uintptr_t)pClassname, OutputId, pClassname),
+		pCaller ? g_EntityProfile.FindOrInsert((uintptr_t)gamehelpers->EntityToReference(pCaller), OutputId, pClassname) : NULL
+	};
+
+	for(ProfileStats *p : pStats)
+	{
+		if(!p)
+			continue;
+
+		p->Fires++;
+		p->Actions += Actions;
+		p->Nanoseconds += Nanoseconds;
+	}
+}
+
+/**
+ * Token bucket rate limits on FireOutput. A bucket refills Rate fires per
+ * second up to Burst. Fires over the limit are dropped, or in defer mode
+ * passed on with the delay until a token would be available, running the
+ * bucket into debt down to -Burst before dropping anyway.
+ */
+enum RateLimitMode
+{
+	RateLimit_Drop = 0,
+	RateLimit_Defer
+};
+
+struct RateBucket
+{
+	float Rate;
+	float Burst;
+	RateLimitMode Mode;
+	float Tokens;
+	float LastTime;
+	uint64_t Dropped;
+	uint64_t Deferred;
+
+	void Init(float flRate, float flBurst, RateLimitMode NewMode)
+	{
+		Rate = flRate;
+		Burst = std::max(flBurst, 1.0f);
+		Mode = NewMode;
+		Tokens = Burst;
+		LastTime = gpGlobals->curtime;
+		Dropped = 0;
+		Deferred = 0;
+	}
+
+	void Refill(float Now)
+	{
+		// curtime starts over on map change.
+		Tokens = std::min(Burst, Tokens + std::max(Now - LastTime, 0.0f) * Rate);
+		LastTime = Now;
+	}
+
+	// Whether Take would let a fire through, without taking anything.
+	bool CanTake(float Now)
+	{
+		Refill(Now);
+		return Tokens >= 1.0f || (Mode == RateLimit_Defer && Tokens - 1.0f >= -Burst);
+	}
+
+	/**
+	 * Takes a token, returns the extra delay to fire with or -1 to drop.
+	 */
+	float Take(float Now)
+	{
+		Refill(Now);
+
+		if(Tokens >= 1.0f)
+		{
+			Tokens -= 1.0f;
+			return 0.0f;
+		}
+
+		if(Mode == RateLimit_Defer && Tokens - 1.0f >= -Burst)
+		{
+			float Wait = (1.0f - Tokens) / Rate;
+			Tokens -= 1.0f;
+			Deferred++;
+			return Wait;
+		}
+
+		Dropped++;
+		return -1.0f;
+	}
+};
+
+// Per entity limits, slotted by entity index and tagged with the reference
+// so a reused index doesn't inherit them.
+struct EntityRateLimit
+{
+	cell_t EntityRef;
+	RateBucket Bucket;
+};
+
+EntityRateLimit g_EntityRateLimits[NUM_ENT_ENTRIES];
+int g_nEntityRateLimits = 0;
+
+#define CLASSRATELIMIT_PENDING	-2
+
+// Per (classname, output) limits, shared by every entity of the class.
+// OutputId -1 covers all outputs of the class without a rule of their own.
+// Output names aren't interned up front, they are resolved against the
+// class's outputs the first time one of its entities fires.
+struct ClassRateLimit
+{
+	int OutputId; // CLASSRATELIMIT_PENDING until Output is resolved
+	std::string Output;
+	RateBucket Bucket;
+
+	const char *Name() const
+	{
+		return OutputId == CLASSRATELIMIT_PENDING ? Output.c_str() : OutputId == -1 ? "*" : OutputIdToName(OutputId);
+	}
+};
+
+std::map<std::string, std::vector<ClassRateLimit>> g_ClassRateLimits; // lowercased classname
+std::unordered_map<const char *, std::vector<ClassRateLimit> *> g_ClassRateLimitCache; // pooled classname -> rules or NULL
+
+uint64_t g_RateLimitDropped = 0;
+uint64_t g_RateLimitDeferred = 0;
+
+inline bool IsRateLimitEnabled()
+{
+	return g_nEntityRateLimits || !g_ClassRateLimits.empty();
+}
+
+EntityRateLimit *GetEntityRateLimit(cell_t EntityRef)
+{
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(Index < 0 || Index >= NUM_ENT_ENTRIES)
+		return NULL;
+
+	EntityRateLimit *pLimit = &g_EntityRateLimits[Index];
+	return pLimit->EntityRef == EntityRef ? pLimit : NULL;
+}
+
+RateBucket *GetClassRateBucket(CBaseEntity *pEntity, int OutputId)
+{
+	const char *pClassname = gamehelpers->GetEntityClassname(pEntity);
+	if(!pClassname)
+		return NULL;
+
+	// Classnames are pooled, so after the first fire this is a pointer hash.
+	auto it = g_ClassRateLimitCache.find(pClassname);
+	if(it == g_ClassRateLimitCache.end())
+	{
+		auto Rules = g_ClassRateLimits.find(GetTargetKey(pClassname));
+		it = g_ClassRateLimitCache.emplace(pClassname, Rules == g_ClassRateLimits.end() ? NULL : &Rules->second).first;
+
+		datamap_t *pMap = it->second ? gamehelpers->GetDataMap(pEntity) : NULL;
+		for(size_t i = 0; pMap && i < it->second->size(); i++)
+		{
+			ClassRateLimit &Rule = (*it->second)[i];
+			if(Rule.OutputId != CLASSRATELIMIT_PENDING)
+				continue;
+
+			// By field or Hammer name, like the rest of the plugin facing names.
+			for(const OutputDesc &Desc : GetDataMapOutputs(pMap))
+			{
+				if(!V_stricmp(Desc.pTypeDesc->fieldName, Rule.Output.c_str()) ||
+					(Desc.pTypeDesc->externalName && !V_stricmp(Desc.pTypeDesc->externalName, Rule.Output.c_str())))
+				{
+					Rule.OutputId = Desc.OutputId;
+					Rule.Output.clear();
+					break;
+				}
+			}
+		}
+	}
+
+	if(it->second == NULL)
+		return NULL;
+
+	RateBucket *pAny = NULL;
+	for(ClassRateLimit &Rule : *it->second)
+	{
+		if(Rule.OutputId == OutputId)
+			return &Rule.Bucket;
+		if(Rule.OutputId == -1)
+			pAny = &Rule.Bucket;
+	}
+
+	return pAny;
+}
+
+/**
+ * Returns the extra delay to fire with, or -1 if the fire is dropped.
+ */
+float ApplyRateLimits(CBaseEntity *pCaller, int OutputId)
+{
+	float Now = gpGlobals->curtime;
+	float Delay = 0.0f;
+
+	RateBucket *pEntityBucket = NULL;
+	if(g_nEntityRateLimits)
+	{
+		EntityRateLimit *pLimit = GetEntityRateLimit(gamehelpers->EntityToReference(pCaller));
+		if(pLimit)
+			pEntityBucket = &pLimit->Bucket;
+	}
+
+	RateBucket *pClassBucket = g_ClassRateLimits.empty() ? NULL : GetClassRateBucket(pCaller, OutputId);
+
+	// Check both before taking from either, a fire the class drops mustn't cost the entity a token.
+	RateBucket *pDropping = (pEntityBucket && !pEntityBucket->CanTake(Now)) ? pEntityBucket :
+		(pClassBucket && !pClassBucket->CanTake(Now)) ? pClassBucket : NULL;
+	if(pDropping)
+	{
+		pDropping->Dropped++;
+		g_RateLimitDropped++;
+		return -1.0f;
+	}
+
+	if(pEntityBucket)
+		Delay = pEntityBucket->Take(Now);
+
+	if(pClassBucket)
+		Delay = std::max(Delay, pClassBucket->Take(Now));
+
+	if(Delay > 0.0f)
+		g_RateLimitDeferred++;
+
+	return Delay;
+}
+
+/**
+ * Causal chain tracing. A FireOutput outside of any traced input starts a
+ * chain and every action it queues is remembered by its IDStamp, which the
+ * event queue hands back as AcceptInput's outputID. Whatever that input fires
+ * continues the same chain one level deeper.
+ */
+struct OutputChainEntry
+{
+	int Id;
+	cell_t Root;
+	int OutputId;
+	float StartTime;
+	float EndTime; // last input delivered
+	int Depth;
+	int Actions; // actions queued over the whole chain
+	int Inputs; // inputs delivered
+};
+
+struct OutputChain
+{
+	OutputChainEntry Entry;
+	int Pending; // queued actions neither delivered nor expired
+};
+
+struct OutputChainHop
+{
+	int ChainId;
+	int Depth;
+	float FireTime;
+	int Tick; // tick it was delivered on or -1
+};
+
+// Open chains and queued hops are bounded, anything past that isn't traced.
+#define OUTPUT_CHAIN_MAX_OPEN	4096
+#define OUTPUT_CHAIN_MAX_HOPS	65536
+#define OUTPUT_CHAIN_HISTORY	1024
+
+std::unordered_map<int, OutputChain> g_OpenOutputChains;
+std::unordered_multimap<int, OutputChainHop> g_OutputChainHops; // by IDStamp
+int g_NextOutputChainId = 1;
+int g_CurrentOutputChain = 0;
+int g_CurrentOutputChainDepth = 0;
+unsigned int g_OutputChainOverflows = 0;
+bool g_bOutputChainsEnabled = false;
+
+OutputChainEntry g_aOutputChainHistory[OUTPUT_CHAIN_HISTORY];
+unsigned int g_OutputChainHistoryHead = 0;
+unsigned int g_OutputChainHistoryTail = 0;
+
+void RecordOutputChainFire(CBaseEntityOutput *pEntityOutput, CBaseEntity *pCaller, int OutputId, float fDelay)
+{
+	if(pEntityOutput->m_ActionList == NULL)
+		return;
+
+	auto it = g_OpenOutputChains.find(g_CurrentOutputChain);
+	int Depth = g_CurrentOutputChainDepth + 1;
+	if(it == g_OpenOutputChains.end())
+	{
+		if(g_OpenOutputChains.size() >= OUTPUT_CHAIN_MAX_OPEN)
+		{
+			g_OutputChainOverflows++;
+			return;
+		}
+
+		int Id = g_NextOutputChainId++;
+		it = g_OpenOutputChains.emplace(Id, OutputChain()).first;
+
+		OutputChainEntry &Entry = it->second.Entry;
+		Entry.Id = Id;
+		Entry.Root = EntityToTraceRef(pCaller);
+		Entry.OutputId = OutputId;
+		Entry.StartTime = Entry.EndTime = gpGlobals->curtime;
+		Entry.Depth = Entry.Actions = Entry.Inputs = 0;
+		it->second.Pending = 0;
+		Depth = 1;
+	}
+
+	OutputChain &Chain = it->second;
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+	{
+		if(g_OutputChainHops.size() >= OUTPUT_CHAIN_MAX_HOPS)
+		{
+			g_OutputChainOverflows++;
+			break;
+		}
+
+		g_OutputChainHops.emplace(ev->m_iIDStamp, OutputChainHop{ it->first, Depth, gpGlobals->curtime + fDelay + ev->m_flDelay, -1 });
+		Chain.Entry.Actions++;
+		Chain.Pending++;
+	}
+}
+
+/**
+ * Output value watches. COutputInt and friends store the new value right
+ * before firing, so the FireOutput detour compares it with the last one seen
+ * and only calls the watchers when it differs.
+ */
+struct OutputValueWatcher
+{
+	IPluginContext *pContext;
+	IPluginFunction *pFunction;
+	cell_t Data;
+};
+
+struct OutputValueWatch
+{
+	cell_t EntityRef;
+	int OutputId;
+	varianthax_t Value;
+	std::vector<OutputValueWatcher> Watchers;
+};
+
+std::unordered_map<CBaseEntityOutput *, OutputValueWatch> g_OutputValueWatches;
+
+bool VariantEquals(const varianthax_t &a, const varianthax_t &b)
+{
+	if(a.fieldType != b.fieldType)
+		return false;
+
+	switch(a.fieldType)
+	{
+	case FIELD_VOID:
+		return true;
+	case FIELD_STRING:
+	case FIELD_MODELNAME:
+	case FIELD_SOUNDNAME:
+		return !strcmp(a.iszVal.ToCStr(), b.iszVal.ToCStr());
+	case FIELD_BOOLEAN:
+		return a.bVal == b.bVal;
+	case FIELD_FLOAT:
+	case FIELD_TIME:
+		return a.flVal == b.flVal;
+	case FIELD_VECTOR:
+	case FIELD_POSITION_VECTOR:
+		return a.vecVal[0] == b.vecVal[0] && a.vecVal[1] == b.vecVal[1] && a.vecVal[2] == b.vecVal[2];
+	case FIELD_EHANDLE:
+		return a.eVal.ToInt() == b.eVal.ToInt();
+	default:
+		return a.iVal == b.iVal;
+	}
+}
+
+void UpdateFireOutputDetour();
+
+void CheckOutputValueWatch(CBaseEntityOutput *pEntityOutput)
+{
+	auto it = g_OutputValueWatches.find(pEntityOutput);
+	if(it == g_OutputValueWatches.end())
+		return;
+
+	OutputValueWatch &Watch = it->second;
+
+	// Without SDKHooks nothing drops the watch when its entity goes away,
+	// and the address may belong to another entity's output by now.
+	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(Watch.EntityRef);
+	if(!pEntity || IdentifyOutput(pEntity, pEntityOutput) != Watch.OutputId)
+	{
+		g_OutputValueWatches.erase(it);
+		UpdateFireOutputDetour();
+		return;
+	}
+	const varianthax_t &Value = pEntityOutput->m_Value;
+	if(VariantEquals(Watch.Value, Value))
+		return;
+
+	Watch.Value = Value;
+
+	cell_t Cell;
+	switch(Value.fieldType)
+	{
+	case FIELD_FLOAT:
+	case FIELD_TIME:
+		Cell = sp_ftoc(Value.flVal);
+		break;
+	case FIELD_BOOLEAN:
+		Cell = Value.bVal;
+		break;
+	case FIELD_EHANDLE:
+		Cell = HandleToBCompatRef(Value.eVal);
+		break;
+	case FIELD_STRING:
+	case FIELD_MODELNAME:
+	case FIELD_SOUNDNAME:
+	case FIELD_VECTOR:
+	case FIELD_POSITION_VECTOR:
+		Cell = 0;
+		break;
+	default:
+		Cell = Value.iVal;
+		break;
+	}
+
+	char aBuffer[256];
+	const char *pValue = FormatVariant(Value, aBuffer, sizeof(aBuffer));
+	cell_t Entity = gamehelpers->ReferenceToBCompatRef(Watch.EntityRef);
+	const char *pOutput = OutputIdToName(Watch.OutputId);
+	int FieldType = Value.fieldType;
+
+	// Callbacks may unwatch, which can free Watch.
+	std::vector<OutputValueWatcher> Watchers = Watch.Watchers;
+	for(const OutputValueWatcher &Watcher : Watchers)
+	{
+		Watcher.pFunction->PushCell(Entity);
+		Watcher.pFunction->PushString(pOutput);
+		Watcher.pFunction->PushCell(FieldType);
+		Watcher.pFunction->PushCell(Cell);
+		Watcher.pFunction->PushString(pValue);
+		Watcher.pFunction->PushCell(Watcher.Data);
+		Watcher.pFunction->Execute(NULL);
+	}
+}
+
+DETOUR_DECL_MEMBER4(CBaseEntityOutput_FireOutput, void, variant_t, Value, CBaseEntity *, pActivator, CBaseEntity *, pCaller, float, fDelay)
+{
+	CBaseEntityOutput *pThis = reinterpret_cast<CBaseEntityOutput *>(this);
+
+	// Before the rate limiter, a dropped fire still changed the value.
+	if(!g_OutputValueWatches.empty())
+		CheckOutputValueWatch(pThis);
+
+	// The caller is the entity owning the output for everything but a few
+	// hand-rolled FireOutput calls, for those the output stays unknown.
+	int OutputId = pCaller ? IdentifyOutput(pCaller, pThis) : -1;
+
+	if(pCaller && IsRateLimitEnabled())
+	{
+		float Extra = ApplyRateLimits(pCaller, OutputId);
+		if(Extra < 0.0f)
+			return;
+
+		fDelay += Extra;
+	}
+
+	// Count before firing, actions that run out of fires are removed by it.
+	int Actions = pThis->NumberOfElements();
+
+	if(g_bOutputTraceEnabled)
+		RecordOutputTrace(pActivator, pCaller, OutputId, Actions);
+
+	if(g_bOutputChainsEnabled)
+		RecordOutputChainFire(pThis, pCaller, OutputId, fDelay);
+
+	if(!g_bOutputProfileEnabled)
+	{
+		DETOUR_MEMBER_CALL(CBaseEntityOutput_FireOutput)(Value, pActivator, pCaller, fDelay);
+	}
+	else
+	{
+		auto Start = std::chrono::steady_clock::now();
+		DETOUR_MEMBER_CALL(CBaseEntityOutput_FireOutput)(Value, pActivator, pCaller, fDelay);
+		auto Elapsed = std::chrono::steady_clock::now() - Start;
+
+		RecordOutputProfile(pCaller, OutputId, Actions, std::chrono::duration_cast<std::chrono::nanoseconds>(Elapsed).count());
+	}
+
+	// Inputs only run later from the event queue, so anything gone now ran out of fires.
+	if(pThis->NumberOfElements() < Actions)
+	{
+		g_OutputListEpoch++;
+		if(pCaller)
+		{
+			MarkEntityOutputsChanged(pCaller);
+			if(!g_OutputSubscriptions.empty())
+				NotifyOutputChanged(pCaller, OutputId, OutputChange_Consumed);
+		}
+	}
+}
+
+void UpdateFireOutputDetour()
+{
+	if(!g_pFireOutputDetour)
+		return;
+
+	bool bNeeded = g_bOutputTraceEnabled || g_bOutputChainsEnabled || g_bOutputProfileEnabled || IsRateLimitEnabled() || !g_OutputSubscriptions.empty() || !g_OutputValueWatches.empty();
+	if(bNeeded && !g_pFireOutputDetour->IsEnabled())
+	{
+		// Consumes went unseen until now, don't let iterators trust their epoch.
+		g_OutputListEpoch++;
+		g_pFireOutputDetour->EnableDetour();
+	}
+	else if(!bNeeded && g_pFireOutputDetour->IsEnabled())
+		g_pFireOutputDetour->DisableDetour();
+}
+
+bool EnableOutputTrace(bool bEnabled)
+{
+	if(!g_pFireOutputDetour)
+		return false;
+
+	g_bOutputTraceEnabled = bEnabled;
+	UpdateFireOutputDetour();
+	return true;
+}
+
+cell_t SetOutputTraceEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	return EnableOutputTrace(params[1] != 0);
+}
+
+cell_t IsOutputTraceEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	return g_bOutputTraceEnabled;
+}
+
+cell_t DrainOutputTrace(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], sizeof(OutputTraceEntry) / sizeof(cell_t));
+	if(pArray == NULL)
+		return -1;
+
+	int Max = params[2];
+	int Count = 0;
+	while(g_OutputTraceTail != g_OutputTraceHead && (Max <= 0 || Count < Max))
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		memcpy(pBlock, &g_aOutputTrace[g_OutputTraceTail++ % OUTPUT_TRACE_SIZE], sizeof(OutputTraceEntry));
+		Count++;
+	}
+
+	return Count;
+}
+
+void GetTraceEntityName(cell_t Entity, char *pBuffer, size_t Size)
+{
+	CBaseEntity *pEntity = Entity != -1 ? gamehelpers->ReferenceToEntity(Entity) : NULL;
+	ke::SafeStrcpy(pBuffer, Size, Entity == -1 ? "-" : pEntity ? GetEntityName(pEntity) : "<deleted>");
+}
+
+CON_COMMAND(sm_outputinfo_trace, "sm_outputinfo_trace <on|off|clear|dump [count]> - Record every FireOutput into a ring buffer")
+{
+	const char *pCmd = args.ArgC() >= 2 ? args.Arg(1) : "";
+
+	if(!strcmp(pCmd, "on") || !strcmp(pCmd, "off"))
+	{
+		if(!EnableOutputTrace(pCmd[1] == 'n'))
+			META_CONPRINT("[OutputInfo] FireOutput detour is not available on this game.\n");
+		else
+			META_CONPRINTF("[OutputInfo] Output tracing %s.\n", g_bOutputTraceEnabled ? "enabled" : "disabled");
+	}
+	else if(!strcmp(pCmd, "clear"))
+	{
+		g_OutputTraceTail = g_OutputTraceHead;
+	}
+	else if(!strcmp(pCmd, "dump"))
+	{
+		unsigned int Count = args.ArgC() >= 3 ? atoi(args.Arg(2)) : 50;
+		unsigned int Available = g_OutputTraceHead - g_OutputTraceTail;
+		if(Count > Available)
+			Count = Available;
+
+		for(unsigned int i = g_OutputTraceHead - Count; i != g_OutputTraceHead; i++)
+		{
+			const OutputTraceEntry &Entry = g_aOutputTrace[i % OUTPUT_TRACE_SIZE];
+			char aEntity[256], aActivator[256], aCaller[256];
+			GetTraceEntityName(Entry.Entity, aEntity, sizeof(aEntity));
+			GetTraceEntityName(Entry.Activator, aActivator, sizeof(aActivator));
+			GetTraceEntityName(Entry.Caller, aCaller, sizeof(aCaller));
+
+			META_CONPRINTF("%d %s.%s -> %d actions (activator %s, caller %s)\n",
+				Entry.Tick,
+				aEntity,
+				Entry.OutputId != -1 ? OutputIdToName(Entry.OutputId) : "?",
+				Entry.Actions,
+				aActivator,
+				aCaller);
+		}
+	}
+	else
+	{
+		META_CONPRINTF("Usage: sm_outputinfo_trace <on|off|clear|dump [count]> (tracing is %s, %u entries buffered)\n",
+			g_bOutputTraceEnabled ? "on" : "off", g_OutputTraceHead - g_OutputTraceTail);
+	}
+}
+
+CDetour *g_pAcceptInputDetour = NULL;
+
+DETOUR_DECL_MEMBER5(CBaseEntity_AcceptInput, bool, const char *, szInputName, CBaseEntity *, pActivator, CBaseEntity *, pCaller, variant_t, Value, int, outputID)
+{
+	int PrevChain = g_CurrentOutputChain;
+	int PrevDepth = g_CurrentOutputChainDepth;
+
+	// Direct inputs carry no stamp and stay in whatever chain is running.
+	OutputChainHop *pHop = NULL;
+	if(outputID)
+	{
+		// An action fired twice can be queued more than once, take the one due
+		// first. A target name matching several entities delivers the same hop
+		// to each of them within one tick.
+		OutputChainHop *pDelivered = NULL;
+		auto Range = g_OutputChainHops.equal_range(outputID);
+		for(auto it = Range.first; it != Range.second; ++it)
+		{
+			OutputChainHop &Hop = it->second;
+			if(Hop.Tick == gpGlobals->tickcount)
+				pDelivered = &Hop;
+			else if(Hop.Tick == -1 && Hop.FireTime <= gpGlobals->curtime + 0.001f && (!pHop || Hop.FireTime < pHop->FireTime))
+				pHop = &Hop;
+		}
+
+		if(pHop == NULL)
+			pHop = pDelivered;
+	}
+
+	if(pHop)
+	{
+		auto it = g_OpenOutputChains.find(pHop->ChainId);
+		if(it != g_OpenOutputChains.end())
+		{
+			OutputChain &Chain = it->second;
+			if(pHop->Tick == -1)
+			{
+				pHop->Tick = gpGlobals->tickcount;
+				Chain.Pending--;
+			}
+
+			Chain.Entry.Inputs++;
+			Chain.Entry.EndTime = gpGlobals->curtime;
+			Chain.Entry.Depth = std::max(Chain.Entry.Depth, pHop->Depth);
+
+			g_CurrentOutputChain = pHop->ChainId;
+			g_CurrentOutputChainDepth = pHop->Depth;
+		}
+	}
+	else if(outputID)
+	{
+		g_CurrentOutputChain = 0;
+		g_CurrentOutputChainDepth = 0;
+	}
+
+	bool bResult = DETOUR_MEMBER_CALL(CBaseEntity_AcceptInput)(szInputName, pActivator, pCaller, Value, outputID);
+
+	g_CurrentOutputChain = PrevChain;
+	g_CurrentOutputChainDepth = PrevDepth;
+	return bResult;
+}
+
+/**
+ * Hops whose fire time passed without an input (target gone, event cancelled)
+ * expire here, and chains with nothing left in flight move into the history.
+ */
+void SweepOutputChains(bool simulating)
+{
+	// The event queue is serviced after frame hooks, leave it some slack.
+	if(gpGlobals->tickcount % 8)
+		return;
+
+	float Expired = gpGlobals->curtime - 0.1f;
+	for(auto it = g_OutputChainHops.begin(); it != g_OutputChainHops.end(); )
+	{
+		OutputChainHop &Hop = it->second;
+		if(Hop.Tick == -1 ? Hop.FireTime >= Expired : Hop.Tick == gpGlobals->tickcount)
+		{
+			++it;
+			continue;
+		}
+
+		if(Hop.Tick == -1)
+		{
+			auto Chain = g_OpenOutputChains.find(Hop.ChainId);
+			if(Chain != g_OpenOutputChains.end())
+				Chain->second.Pending--;
+		}
+
+		it = g_OutputChainHops.erase(it);
+	}
+
+	for(auto it = g_OpenOutputChains.begin(); it != g_OpenOutputChains.end(); )
+	{
+		if(it->second.Pending > 0)
+		{
+			++it;
+			continue;
+		}
+
+		g_aOutputChainHistory[g_OutputChainHistoryHead++ % OUTPUT_CHAIN_HISTORY] = it->second.Entry;
+		if(g_OutputChainHistoryHead - g_OutputChainHistoryTail > OUTPUT_CHAIN_HISTORY)
+			g_OutputChainHistoryTail = g_OutputChainHistoryHead - OUTPUT_CHAIN_HISTORY;
+
+		it = g_OpenOutputChains.erase(it);
+	}
+}
+
+void ClearOutputChains(bool bHistory)
+{
+	g_OpenOutputChains.clear();
+	g_OutputChainHops.clear();
+	g_CurrentOutputChain = 0;
+	g_CurrentOutputChainDepth = 0;
+
+	if(bHistory)
+		g_OutputChainHistoryTail = g_OutputChainHistoryHead;
+}
+
+bool EnableOutputChains(bool bEnabled)
+{
+	if(!g_pFireOutputDetour || !g_pAcceptInputDetour)
+		return false;
+
+	if(bEnabled == g_bOutputChainsEnabled)
+		return true;
+
+	g_bOutputChainsEnabled = bEnabled;
+	if(bEnabled)
+	{
+		g_pAcceptInputDetour->EnableDetour();
+		smutils->AddGameFrameHook(SweepOutputChains);
+	}
+	else
+	{
+		g_pAcceptInputDetour->DisableDetour();
+		smutils->RemoveGameFrameHook(SweepOutputChains);
+		ClearOutputChains(false);
+	}
+
+	UpdateFireOutputDetour();
+	return true;
+}
+
+cell_t SetOutputChainTraceEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	return EnableOutputChains(params[1] != 0);
+}
+
+cell_t IsOutputChainTraceEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	return g_bOutputChainsEnabled;
+}
+
+// Finished chains that were last active within the past Seconds, or all if <= 0.
+std::vector<OutputChainEntry> GetRecentOutputChains(float Seconds)
+{
+	std::vector<OutputChainEntry> Chains;
+	for(unsigned int i = g_OutputChainHistoryTail; i != g_OutputChainHistoryHead; i++)
+	{
+		const OutputChainEntry &Entry = g_aOutputChainHistory[i % OUTPUT_CHAIN_HISTORY];
+		if(Seconds <= 0.0f || Entry.EndTime >= gpGlobals->curtime - Seconds)
+			Chains.push_back(Entry);
+	}
+
+	return Chains;
+}
+
+cell_t GetOutputChains(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], sizeof(OutputChainEntry) / sizeof(cell_t));
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+
+	std::vector<OutputChainEntry> Chains = GetRecentOutputChains(sp_ctof(params[2]));
+	for(const OutputChainEntry &Entry : Chains)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		memcpy(pBlock, &Entry, sizeof(OutputChainEntry));
+	}
+
+	return Chains.size();
+}
+
+CON_COMMAND(sm_outputinfo_chains, "sm_outputinfo_chains <on|off|clear|slowest|deepest [seconds] [count]> - Trace output chains through the event queue")
+{
+	const char *pCmd = args.ArgC() >= 2 ? args.Arg(1) : "";
+
+	if(!strcmp(pCmd, "on") || !strcmp(pCmd, "off"))
+	{
+		if(!EnableOutputChains(pCmd[1] == 'n'))
+			META_CONPRINT("[OutputInfo] FireOutput or AcceptInput detour is not available on this game.\n");
+		else
+			META_CONPRINTF("[OutputInfo] Output chain tracing %s.\n", g_bOutputChainsEnabled ? "enabled" : "disabled");
+	}
+	else if(!strcmp(pCmd, "clear"))
+	{
+		ClearOutputChains(true);
+	}
+	else if(!strcmp(pCmd, "slowest") || !strcmp(pCmd, "deepest"))
+	{
+		float Seconds = args.ArgC() >= 3 ? atof(args.Arg(2)) : 0.0f;
+		size_t Count = args.ArgC() >= 4 ? atoi(args.Arg(3)) : 20;
+
+		std::vector<OutputChainEntry> Chains = GetRecentOutputChains(Seconds);
+		if(pCmd[0] == 's')
+		{
+			std::stable_sort(Chains.begin(), Chains.end(), [](const OutputChainEntry &a, const OutputChainEntry &b)
+			{
+				return a.EndTime - a.StartTime > b.EndTime - b.StartTime;
+			});
+		}
+		else
+		{
+			std::stable_sort(Chains.begin(), Chains.end(), [](const OutputChainEntry &a, const OutputChainEntry &b)
+			{
+				return a.Depth != b.Depth ? a.Depth > b.Depth : a.Actions > b.Actions;
+			});
+		}
+
+		META_CONPRINTF("%-8s %-48s %6s %8s %8s %10s %10s\n", "Chain", "Root", "Depth", "Actions", "Inputs", "Elapsed", "Ago");
+		for(size_t i = 0; i < Chains.size() && i < Count; i++)
+		{
+			const OutputChainEntry &Entry = Chains[i];
+			char aRoot[256], aName[320];
+			GetTraceEntityName(Entry.Root, aRoot, sizeof(aRoot));
+			snprintf(aName, sizeof(aName), "%s.%s", aRoot, Entry.OutputId != -1 ? OutputIdToName(Entry.OutputId) : "?");
+
+			META_CONPRINTF("%-8d %-48s %6d %8d %8d %9.3fs %9.1fs\n", Entry.Id, aName, Entry.Depth, Entry.Actions, Entry.Inputs,
+				Entry.EndTime - Entry.StartTime, gpGlobals->curtime - Entry.EndTime);
+		}
+	}
+	else
+	{
+		META_CONPRINTF("Usage: sm_outputinfo_chains <on|off|clear|slowest|deepest [seconds] [count]> (tracing is %s, %u open, %u finished, %u overflows)\n",
+			g_bOutputChainsEnabled ? "on" : "off", (unsigned int)g_OpenOutputChains.size(),
+			g_OutputChainHistoryHead - g_OutputChainHistoryTail, g_OutputChainOverflows);
+	}
+}
+
+bool EnableOutputProfile(bool bEnabled)
+{
+	if(!g_pFireOutputDetour)
+		return false;
+
+	g_bOutputProfileEnabled = bEnabled;
+	UpdateFireOutputDetour();
+	return true;
+}
+
+void ClearOutputProfile()
+{
+	g_ClassProfile.Clear();
+	g_EntityProfile.Clear();
+}
+
+template <size_t SIZE>
+void SortProfileTable(const ProfileTable<SIZE> &Table, std::vector<const typename ProfileTable<SIZE>::Entry *> &Sorted)
+{
+	Sorted.clear();
+	for(size_t i = 0; i < Table.Capacity(); i++)
+	{
+		if(Table.At(i).bUsed)
+			Sorted.push_back(&Table.At(i));
+	}
+
+	std::sort(Sorted.begin(), Sorted.end(), [](const typename ProfileTable<SIZE>::Entry *a, const typename ProfileTable<SIZE>::Entry *b)
+	{
+		return a->Stats.Nanoseconds > b->Stats.Nanoseconds;
+	});
+}
+
+/**
+ * Cell layout of enum struct OutputProfileEntry in outputinfo.inc.
+ */
+#define PROFILE_CLASSNAME		0	// char[64]
+#define PROFILE_OUTPUTID		16
+#define PROFILE_ENTITY			17
+#define PROFILE_FIRES			18
+#define PROFILE_ACTIONS			19
+#define PROFILE_TIME			20
+#define PROFILE_CELLS			21
+
+template <size_t SIZE>
+cell_t WriteProfileTable(IPluginContext *pContext, ICellArray *pArray, const ProfileTable<SIZE> &Table, bool bEntities)
+{
+	std::vector<const typename ProfileTable<SIZE>::Entry *> Sorted;
+	SortProfileTable(Table, Sorted);
+
+	for(const typename ProfileTable<SIZE>::Entry *e : Sorted)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		ke::SafeStrcpy((char *)&pBlock[PROFILE_CLASSNAME], (PROFILE_OUTPUTID - PROFILE_CLASSNAME) * sizeof(cell_t), e->aClassname);
+		pBlock[PROFILE_OUTPUTID] = e->OutputId;
+		pBlock[PROFILE_ENTITY] = bEntities ? gamehelpers->ReferenceToBCompatRef((cell_t)e->Owner) : -1;
+		pBlock[PROFILE_FIRES] = (cell_t)e->Stats.Fires;
+		pBlock[PROFILE_ACTIONS] = (cell_t)e->Stats.Actions;
+		pBlock[PROFILE_TIME] = sp_ftoc((float)(e->Stats.Nanoseconds / 1000.0));
+	}
+
+	return (cell_t)Sorted.size();
+}
+
+cell_t SetOutputProfileEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	return EnableOutputProfile(params[1] != 0);
+}
+
+cell_t ResetOutputProfile(IPluginContext *pContext, const cell_t *params)
+{
+	ClearOutputProfile();
+	return 0;
+}
+
+cell_t GetOutputProfile(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], PROFILE_CELLS);
+	if(pArray == NULL)
+		return -1;
+
+	pArray->clear();
+
+	if(params[2])
+		return WriteProfileTable(pContext, pArray, g_EntityProfile, true);
+
+	return WriteProfileTable(pContext, pArray, g_ClassProfile, false);
+}
+
+template <size_t SIZE>
+void PrintProfileTable(const ProfileTable<SIZE> &Table, bool bEntities, size_t Count)
+{
+	std::vector<const typename ProfileTable<SIZE>::Entry *> Sorted;
+	SortProfileTable(Table, Sorted);
+
+	META_CONPRINTF("%-40s %-24s %10s %10s %12s %10s\n", bEntities ? "Entity" : "Classname", "Output", "Fires", "Actions", "Total (ms)", "Avg (us)");
+	for(size_t i = 0; i < Sorted.size() && i < Count; i++)
+	{
+		const typename ProfileTable<SIZE>::Entry *e = Sorted[i];
+
+		char aOwner[256];
+		if(bEntities)
+		{
+			CBaseEntity *pEntity = gamehelpers->ReferenceToEntity((cell_t)e->Owner);
+			ke::SafeSprintf(aOwner, sizeof(aOwner), "%s (%s)", pEntity ? GetEntityName(pEntity) : "<deleted>", e->aClassname);
+		}
+		else
+			ke::SafeStrcpy(aOwner, sizeof(aOwner), e->aClassname);
+
+		META_CONPRINTF("%-40s %-24s %10llu %10llu %12.3f %10.2f\n",
+			aOwner,
+			e->OutputId != -1 ? OutputIdToName(e->OutputId) : "?",
+			(unsigned long long)e->Stats.Fires,
+			(unsigned long long)e->Stats.Actions,
+			e->Stats.Nanoseconds / 1000000.0,
+			e->Stats.Fires ? e->Stats.Nanoseconds / 1000.0 / e->Stats.Fires : 0.0);
+	}
+
+	if(Table.Dropped())
+		META_CONPRINTF("(table full, %llu fires not recorded)\n", (unsigned long long)Table.Dropped());
+}
+
+CON_COMMAND(sm_outputinfo_profile, "sm_outputinfo_profile <start|stop|top [count]|reset> - Profile time spent in FireOutput")
+{
+	const char *pCmd = args.ArgC() >= 2 ? args.Arg(1) : "";
+
+	if(!strcmp(pCmd, "start") || !strcmp(pCmd, "stop"))
+	{
+		if(!EnableOutputProfile(pCmd[2] == 'a'))
+			META_CONPRINT("[OutputInfo] FireOutput detour is not available on this game.\n");
+		else
+			META_CONPRINTF("[OutputInfo] Output profiling %s.\n", g_bOutputProfileEnabled ? "started" : "stopped");
+	}
+	else if(!strcmp(pCmd, "reset"))
+	{
+		ClearOutputProfile();
+	}
+	else if(!strcmp(pCmd, "top"))
+	{
+		size_t Count = args.ArgC() >= 3 ? atoi(args.Arg(2)) : 20;
+		PrintProfileTable(g_ClassProfile, false, Count);
+		META_CONPRINT("\n");
+		PrintProfileTable(g_EntityProfile, true, Count);
+	}
+	else
+	{
+		META_CONPRINTF("Usage: sm_outputinfo_profile <start|stop|top [count]|reset> (profiling is %s)\n",
+			g_bOutputProfileEnabled ? "running" : "stopped");
+	}
+}
+
+bool SetEntityRateLimit(CBaseEntity *pEntity, float flRate, float flBurst, RateLimitMode Mode)
+{
+	cell_t EntityRef = gamehelpers->EntityToReference(pEntity);
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(Index < 0 || Index >= NUM_ENT_ENTRIES)
+		return false;
+
+	EntityRateLimit *pLimit = &g_EntityRateLimits[Index];
+	bool bHadLimit = pLimit->EntityRef == EntityRef;
+
+	if(flRate <= 0.0f)
+	{
+		if(bHadLimit)
+		{
+			pLimit->EntityRef = 0;
+			g_nEntityRateLimits--;
+		}
+	}
+	else
+	{
+		if(!bHadLimit)
+		{
+			// Slots of dead entities are normally cleared already, but not without SDKHooks.
+			if(!pLimit->EntityRef)
+				g_nEntityRateLimits++;
+			pLimit->EntityRef = EntityRef;
+		}
+		pLimit->Bucket.Init(flRate, flBurst, Mode);
+	}
+
+	UpdateFireOutputDetour();
+	return true;
+}
+
+void ClearEntityRateLimit(cell_t EntityRef)
+{
+	int Index = gamehelpers->ReferenceToIndex(EntityRef);
+	if(Index < 0 || Index >= NUM_ENT_ENTRIES || g_EntityRateLimits[Index].EntityRef != EntityRef)
+		return;
+
+	g_EntityRateLimits[Index].EntityRef = 0;
+	g_nEntityRateLimits--;
+	UpdateFireOutputDetour();
+}
+
+// pOutput "" or "*" covers every output of the class.
+void SetClassRateLimit(const char *pClassname, const char *pOutput, float flRate, float flBurst, RateLimitMode Mode)
+{
+	if(!pOutput[0])
+		pOutput = "*";
+
+	std::string Key = GetTargetKey(pClassname);
+	std::vector<ClassRateLimit> &Rules = g_ClassRateLimits[Key];
+
+	auto it = std::find_if(Rules.begin(), Rules.end(), [pOutput](const ClassRateLimit &Rule) { return !V_stricmp(Rule.Name(), pOutput); });
+	if(flRate <= 0.0f)
+	{
+		if(it != Rules.end())
+			Rules.erase(it);
+	}
+	else
+	{
+		if(it == Rules.end())
+		{
+			ClassRateLimit Rule = { -1 };
+			if(strcmp(pOutput, "*"))
+			{
+				Rule.OutputId = CLASSRATELIMIT_PENDING;
+				Rule.Output = pOutput;
+			}
+			it = Rules.insert(Rules.end(), std::move(Rule));
+		}
+		it->Bucket.Init(flRate, flBurst, Mode);
+	}
+
+	if(Rules.empty())
+		g_ClassRateLimits.erase(Key);
+
+	// Rule vectors may have moved or gone away.
+	g_ClassRateLimitCache.clear();
+	UpdateFireOutputDetour();
+}
+
+void ClearRateLimits()
+{
+	for(EntityRateLimit &Limit : g_EntityRateLimits)
+		Limit.EntityRef = 0;
+
+	g_nEntityRateLimits = 0;
+	g_ClassRateLimits.clear();
+	g_ClassRateLimitCache.clear();
+	UpdateFireOutputDetour();
+}
+
+cell_t SetOutputRateLimit(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return false;
+
+	if(!g_pFireOutputDetour)
+		return pContext->ThrowNativeError("FireOutput detour is not available on this game");
+
+	return SetEntityRateLimit(pEntity, sp_ctof(params[2]), sp_ctof(params[3]), params[4] ? RateLimit_Defer : RateLimit_Drop);
+}
+
+cell_t SetOutputClassRateLimit(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_pFireOutputDetour)
+		return pContext->ThrowNativeError("FireOutput detour is not available on this game");
+
+	char *pClassname;
+	char *pOutput;
+	pContext->LocalToString(params[1], &pClassname);
+	pContext->LocalToString(params[2], &pOutput);
+
+	SetClassRateLimit(pClassname, pOutput, sp_ctof(params[3]), sp_ctof(params[4]), params[5] ? RateLimit_Defer : RateLimit_Drop);
+	return 0;
+}
+
+cell_t GetOutputRateLimit(IPluginContext *pContext, const cell_t *params)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return false;
+
+	EntityRateLimit *pLimit = GetEntityRateLimit(gamehelpers->EntityToReference(pEntity));
+	if(pLimit == NULL)
+		return false;
+
+	cell_t *pRate, *pBurst, *pDropped, *pDeferred;
+	pContext->LocalToPhysAddr(params[2], &pRate);
+	pContext->LocalToPhysAddr(params[3], &pBurst);
+	pContext->LocalToPhysAddr(params[4], &pDropped);
+	pContext->LocalToPhysAddr(params[5], &pDeferred);
+
+	*pRate = sp_ftoc(pLimit->Bucket.Rate);
+	*pBurst = sp_ftoc(pLimit->Bucket.Burst);
+	*pDropped = (cell_t)pLimit->Bucket.Dropped;
+	*pDeferred = (cell_t)pLimit->Bucket.Deferred;
+	return true;
+}
+
+cell_t GetOutputRateLimitStats(IPluginContext *pContext, const cell_t *params)
+{
+	cell_t *pDropped, *pDeferred;
+	pContext->LocalToPhysAddr(params[1], &pDropped);
+	pContext->LocalToPhysAddr(params[2], &pDeferred);
+
+	*pDropped = (cell_t)g_RateLimitDropped;
+	*pDeferred = (cell_t)g_RateLimitDeferred;
+	return 0;
+}
+
+cell_t ClearOutputRateLimits(IPluginContext *pContext, const cell_t *params)
+{
+	ClearRateLimits();
+	return 0;
+}
+
+CON_COMMAND(sm_outputinfo_ratelimit, "sm_outputinfo_ratelimit <list|clear|class <classname> <output|*> <rate> [burst] [drop|defer]> - Rate limit output fires")
+{
+	const char *pCmd = args.ArgC() >= 2 ? args.Arg(1) : "";
+
+	if(!strcmp(pCmd, "class") && args.ArgC() >= 5)
+	{
+		if(!g_pFireOutputDetour)
+		{
+			META_CONPRINT("[OutputInfo] FireOutput detour is not available on this game.\n");
+			return;
+		}
+
+		float flRate = atof(args.Arg(4));
+		float flBurst = args.ArgC() >= 6 ? atof(args.Arg(5)) : flRate;
+		RateLimitMode Mode = (args.ArgC() >= 7 && !strcmp(args.Arg(6), "defer")) ? RateLimit_Defer : RateLimit_Drop;
+
+		SetClassRateLimit(args.Arg(2), args.Arg(3), flRate, flBurst, Mode);
+	}
+	else if(!strcmp(pCmd, "clear"))
+	{
+		ClearRateLimits();
+	}
+	else if(!strcmp(pCmd, "list"))
+	{
+		META_CONPRINTF("[OutputInfo] %llu fires dropped, %llu deferred.\n",
+			(unsigned long long)g_RateLimitDropped, (unsigned long long)g_RateLimitDeferred);
+
+		for(const auto &Class : g_ClassRateLimits)
+		{
+			for(const ClassRateLimit &Rule : Class.second)
+			{
+				META_CONPRINTF("  %-32s %-24s %8.2f/s burst %-6g %-5s dropped %llu deferred %llu\n",
+					Class.first.c_str(), Rule.Name(),
+					Rule.Bucket.Rate, Rule.Bucket.Burst, Rule.Bucket.Mode == RateLimit_Defer ? "defer" : "drop",
+					(unsigned long long)Rule.Bucket.Dropped, (unsigned long long)Rule.Bucket.Deferred);
+			}
+		}
+
+		char aEntity[256];
+		for(const EntityRateLimit &Limit : g_EntityRateLimits)
+		{
+			if(!Limit.EntityRef)
+				continue;
+
+			GetTraceEntityName(Limit.EntityRef, aEntity, sizeof(aEntity));
+			META_CONPRINTF("  %-57s %8.2f/s burst %-6g %-5s dropped %llu deferred %llu\n",
+				aEntity, Limit.Bucket.Rate, Limit.Bucket.Burst, Limit.Bucket.Mode == RateLimit_Defer ? "defer" : "drop",
+				(unsigned long long)Limit.Bucket.Dropped, (unsigned long long)Limit.Bucket.Deferred);
+		}
+	}
+	else
+	{
+		META_CONPRINT("Usage: sm_outputinfo_ratelimit <list|clear|class <classname> <output|*> <rate> [burst] [drop|defer]>\n");
+	}
+}
+
+/**
+ * The engine adds actions by parsing output keyvalues, both while spawning and
+ * from the AddOutput input, so that's where new actions are noticed.
+ */
+DETOUR_DECL_MEMBER2(CBaseEntity_KeyValue, bool, const char *, szKeyName, const char *, szValue)
+{
+	CBaseEntity *pEntity = reinterpret_cast<CBaseEntity *>(this);
+
+	if(g_bNameIndexValid && !V_stricmp(szKeyName, "targetname"))
+	{
+		bool bResult = DETOUR_MEMBER_CALL(CBaseEntity_KeyValue)(szKeyName, szValue);
+		IndexEntityName(pEntity);
+		return bResult;
+	}
+
+	// Output values are comma or ESC separated, that rules out most keyvalues cheaply.
+	datamap_t *pMap = NULL;
+	if(strchr(szValue, ',') || strchr(szValue, '\x1B'))
+		pMap = gamehelpers->GetDataMap(pEntity);
+
+	int OutputId = -1;
+	CBaseEntityOutput *pEntityOutput = NULL;
+	if(pMap)
+	{
+		for(const OutputDesc &Desc : GetDataMapOutputs(pMap))
+		{
+			if(Desc.pTypeDesc->externalName && !V_stricmp(Desc.pTypeDesc->externalName, szKeyName))
+			{
+				OutputId = Desc.OutputId;
+				pEntityOutput = (CBaseEntityOutput *)((intptr_t)pEntity + Desc.Offset);
+				break;
+			}
+		}
+	}
+
+	if(pEntityOutput == NULL)
+		return DETOUR_MEMBER_CALL(CBaseEntity_KeyValue)(szKeyName, szValue);
+
+	int Actions = pEntityOutput->NumberOfElements();
+	bool bResult = DETOUR_MEMBER_CALL(CBaseEntity_KeyValue)(szKeyName, szValue);
+
+	if(pEntityOutput->NumberOfElements() != Actions)
+	{
+		g_OutputListEpoch++;
+		MarkEntityOutputsChanged(pEntity);
+		NotifyOutputChanged(pEntity, OutputId, OutputChange_Added);
+	}
+
+	return bResult;
+}
+
+cell_t SubscribeOutputChanges(IPluginContext *pContext, const cell_t *params)
+{
+	IPluginFunction *pFunction = pContext->GetRuntime()->GetFunctionByName("OnEntityOutputChanged");
+	if(pFunction == NULL)
+		return pContext->ThrowNativeError("OnEntityOutputChanged is not implemented");
+
+	char *pOutput;
+	pContext->LocalToString(params[1], &pOutput);
+	if(!pOutput[0])
+		pOutput = (char *)"*";
+
+	for(const OutputSubscription &Subscription : g_OutputSubscriptions)
+	{
+		if(Subscription.pContext == pContext && !V_stricmp(Subscription.Name(), pOutput))
+			return 0;
+	}
+
+	OutputSubscription Subscription = { pContext, pFunction, -1 };
+	if(strcmp(pOutput, "*"))
+	{
+		Subscription.OutputId = FindOutputId(pOutput);
+		if(Subscription.OutputId == -1)
+		{
+			Subscription.OutputId = OUTPUTSUBSCRIPTION_PENDING;
+			Subscription.Output = pOutput;
+		}
+	}
+
+	g_OutputSubscriptions.push_back(std::move(Subscription));
+	UpdateFireOutputDetour();
+	return 0;
+}
+
+// Removes the plugin's subscription to pOutput ("*" for the one to every output), or all of them for NULL.
+void RemoveOutputSubscriptions(IPluginContext *pContext, const char *pOutput)
+{
+	g_OutputSubscriptions.erase(std::remove_if(g_OutputSubscriptions.begin(), g_OutputSubscriptions.end(),
+		[=](const OutputSubscription &Subscription)
+		{
+			return Subscription.pContext == pContext && (!pOutput || !V_stricmp(Subscription.Name(), pOutput));
+		}), g_OutputSubscriptions.end());
+
+	UpdateFireOutputDetour();
+}
+
+cell_t UnsubscribeOutputChanges(IPluginContext *pContext, const cell_t *params)
+{
+	char *pOutput;
+	pContext->LocalToString(params[1], &pOutput);
+
+	RemoveOutputSubscriptions(pContext, pOutput[0] ? pOutput : "*");
+	return 0;
+}
+
+cell_t WatchOutputValueImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	if(!g_pFireOutputDetour)
+		return pContext->ThrowNativeError("FireOutput detour is not available on this game");
+
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return false;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return false;
+
+	IPluginFunction *pFunction = pContext->GetFunctionById(params[3]);
+	if(pFunction == NULL)
+		return pContext->ThrowNativeError("Invalid callback function %x", params[3]);
+
+	// A watch left behind by a destroyed entity at the same address is stale.
+	cell_t EntityRef = gamehelpers->EntityToReference(pEntity);
+	auto it = g_OutputValueWatches.find(pEntityOutput);
+	if(it != g_OutputValueWatches.end() && it->second.EntityRef != EntityRef)
+	{
+		g_OutputValueWatches.erase(it);
+		it = g_OutputValueWatches.end();
+	}
+
+	if(it == g_OutputValueWatches.end())
+	{
+		it = g_OutputValueWatches.emplace(pEntityOutput, OutputValueWatch()).first;
+		it->second.EntityRef = EntityRef;
+		it->second.OutputId = IdentifyOutput(pEntity, pEntityOutput);
+		it->second.Value = pEntityOutput->m_Value;
+	}
+
+	for(OutputValueWatcher &Watcher : it->second.Watchers)
+	{
+		if(Watcher.pFunction == pFunction)
+		{
+			Watcher.Data = params[4];
+			return true;
+		}
+	}
+
+	it->second.Watchers.push_back({ pContext, pFunction, params[4] });
+	UpdateFireOutputDetour();
+	return true;
+}
+OUTPUT_NATIVE(WatchOutputValue)
+
+cell_t UnwatchOutputValueImpl(IPluginContext *pContext, const cell_t *params, bool ById)
+{
+	CBaseEntity *pEntity = GetEntityParam(params[1]);
+	if(!pEntity)
+		return false;
+
+	CBaseEntityOutput *pEntityOutput = GetOutputParam(pContext, pEntity, params[2], ById);
+	if(pEntityOutput == NULL)
+		return false;
+
+	auto it = g_OutputValueWatches.find(pEntityOutput);
+	if(it == g_OutputValueWatches.end())
+		return false;
+
+	IPluginFunction *pFunction = pContext->GetFunctionById(params[3]);
+	std::vector<OutputValueWatcher> &Watchers = it->second.Watchers;
+	size_t Count = Watchers.size();
+	Watchers.erase(std::remove_if(Watchers.begin(), Watchers.end(),
+		[=](const OutputValueWatcher &Watcher)
+		{
+			return Watcher.pFunction == pFunction;
+		}), Watchers.end());
+
+	bool bRemoved = Watchers.size() != Count;
+	if(Watchers.empty())
+	{
+		g_OutputValueWatches.erase(it);
+		UpdateFireOutputDetour();
+	}
+
+	return bRemoved;
+}
+OUTPUT_NATIVE(UnwatchOutputValue)
+
+// Drops the watches of one plugin (pContext) or one entity (EntityRef), or all of them.
+void RemoveOutputValueWatches(IPluginContext *pContext, cell_t EntityRef)
+{
+	for(auto it = g_OutputValueWatches.begin(); it != g_OutputValueWatches.end(); )
+	{
+		std::vector<OutputValueWatcher> &Watchers = it->second.Watchers;
+		if(EntityRef == 0 || it->second.EntityRef == EntityRef)
+		{
+			Watchers.erase(std::remove_if(Watchers.begin(), Watchers.end(),
+				[=](const OutputValueWatcher &Watcher)
+				{
+					return pContext == NULL || Watcher.pContext == pContext;
+				}), Watchers.end());
+		}
+
+		if(Watchers.empty())
+			it = g_OutputValueWatches.erase(it);
+		else
+			++it;
+	}
+
+	UpdateFireOutputDetour();
+}
+
+/**
+ * Per-map output rules read from configs/outputinfo/maps/<map>.cfg:
+ *
+ * "OutputRules"
+ * {
+ *     "<rule name>"
+ *     {
+ *         "classname"     "func_button"   // optional
+ *         "targetname"    "boss_*"        // optional
+ *         "output"        "OnPressed"     // Hammer name, or the m_OnPressed field
+ *         "target"        "boss_door"     // optional action criteria, like FindOutput
+ *         "input"         "Open"
+ *         "parameter"     ""
+ *         "delay"         "0.0"
+ *         "times"         "-1"
+ *         "action"        "delete"        // delete, modify or add
+ *         "set_target"    "boss_door2"    // new values for modify and add
+ *         "set_input"     "Close"
+ *         "set_parameter" ""
+ *         "set_delay"     "1.0"
+ *         "set_times"     "1"
+ *     }
+ * }
+ *
+ * Strings match case insensitively and may contain * wildcards. add ignores
+ * the action criteria and skips outputs that already have the same action,
+ * so applying a file twice doesn't double up.
+ *
+ * All rules are applied in one pass over the entity list when the map starts,
+ * and to entities created later on the next frame. Rules are indexed by
+ * output id the first time a class with a matching output shows up, an
+ * entity only looks at the rules for outputs its class has.
+ */
+enum OutputRuleAction
+{
+	OutputRule_Delete = 0,
+	OutputRule_Modify,
+	OutputRule_Add
+};
+
+#define OUTPUTRULE_SET_TARGET		(1<<0)
+#define OUTPUTRULE_SET_TARGETINPUT	(1<<1)
+#define OUTPUTRULE_SET_PARAMETER	(1<<2)
+#define OUTPUTRULE_SET_DELAY		(1<<3)
+#define OUTPUTRULE_SET_TIMESTOFIRE	(1<<4)
+
+// Plain strings skip the glob matcher.
+inline int GetOutputRuleFlags(const char *pPattern)
+{
+	return OUTPUTFILTER_NOCASE | (pPattern && strpbrk(pPattern, "*?") ? OUTPUTFILTER_WILDCARD : 0);
+}
+
+struct OutputRule
+{
+	OutputRule(const char *pClassname, const char *pTargetname, const char *pTarget, const char *pTargetInput, const char *pParameter, float flDelay, int nTimesToFire) :
+		Classname(pClassname, GetOutputRuleFlags(pClassname)),
+		Targetname(pTargetname, GetOutputRuleFlags(pTargetname)),
+		Filter(pTarget, pTargetInput, pParameter, flDelay, nTimesToFire,
+			GetOutputRuleFlags(pTarget) | GetOutputRuleFlags(pTargetInput) | GetOutputRuleFlags(pParameter))
+	{
+	}
+
+	std::string Name;
+	std::string Output;
+	int OutputId = -1; // -1 until a class with the output is seen
+	OutputRuleAction Action = OutputRule_Delete;
+	StringMatcher Classname;
+	StringMatcher Targetname;
+	OutputFilter Filter;
+
+	// New values, the strings are pooled when the rules are loaded.
+	int SetFields = 0;
+	string_t iSetTarget = NULL_STRING;
+	string_t iSetTargetInput = NULL_STRING;
+	string_t iSetParameter = NULL_STRING;
+	float flSetDelay = 0.0f;
+	int nSetTimesToFire = -1;
+
+	int Entities = 0;
+	int Actions = 0;
+
+	int Apply(CBaseEntityOutput *pEntityOutput);
+};
+
+int OutputRule::Apply(CBaseEntityOutput *pEntityOutput)
+{
+	if(Action == OutputRule_Delete)
+		return pEntityOutput->DeleteMatchingElements(Filter);
+
+	if(Action == OutputRule_Modify)
+	{
+		int Count = 0;
+		for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+		{
+			if(!Filter.Matches(ev))
+				continue;
+
+			if(SetFields & OUTPUTRULE_SET_TARGET)
+				ev->m_iTarget = iSetTarget;
+			if(SetFields & OUTPUTRULE_SET_TARGETINPUT)
+				ev->m_iTargetInput = iSetTargetInput;
+			if(SetFields & OUTPUTRULE_SET_PARAMETER)
+				ev->m_iParameter = iSetParameter;
+			if(SetFields & OUTPUTRULE_SET_DELAY)
+				ev->m_flDelay = flSetDelay;
+			if(SetFields & OUTPUTRULE_SET_TIMESTOFIRE)
+				ev->m_nTimesToFire = nSetTimesToFire;
+			Count++;
+		}
+
+		return Count;
+	}
+
+	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+	{
+		if(ev->m_iTarget == iSetTarget && ev->m_iTargetInput == iSetTargetInput && ev->m_iParameter == iSetParameter &&
+			ev->m_flDelay == flSetDelay && ev->m_nTimesToFire == nSetTimesToFire)
+			return 0;
+	}
+
+	CEventAction *pAction = CEventAction::Create(iSetTarget, iSetTargetInput, iSetParameter, flSetDelay, nSetTimesToFire);
+	if(pAction == NULL)
+		return 0;
+
+	pEntityOutput->InsertElement(-1, pAction);
+	return 1;
+}
+
+std::vector<std::unique_ptr<OutputRule>> g_OutputRules;
+std::unordered_map<std::string, std::vector<OutputRule *>> g_OutputRulesByName; // lowercased output
+std::vector<std::vector<OutputRule *>> g_OutputRulesByOutput; // indexed by output id
+std::vector<uint8_t> g_OutputRulesResolved; // whether an output id was looked up by name yet
+std::vector<cell_t> g_PendingRuleEntities;
+bool g_bOutputRulesActive = false;
+bool g_bOutputRulesLoaded = false; // for the current map, whether or not it has a file
+bool g_bOutputRulesMapLoading = false; // between level init and map start
+
+struct OutputRulesStats
+{
+	std::string Path;
+	double LoadTime; // microseconds
+	double ApplyTime; // microseconds, map entities and later ones
+	int MapEntities;
+	int LateEntities;
+	int Errors;
+};
+
+OutputRulesStats g_OutputRulesStats;
+
+/**
+ * Collects the keys of each rule section, rules are compiled when their
+ * section closes.
+ */
+class OutputRulesParser : public ITextListener_SMC
+{
+public:
+	SMCResult ReadSMC_NewSection(const SMCStates *states, const char *name)
+	{
+		m_Depth++;
+		if(m_Depth == 2)
+		{
+			m_Name = name;
+			m_Line = states->line;
+			m_Keys.clear();
+		}
+
+		return SMCResult_Continue;
+	}
+
+	SMCResult ReadSMC_KeyValue(const SMCStates *states, const char *key, const char *value)
+	{
+		if(m_Depth == 2)
+			m_Keys[GetTargetKey(key)] = value;
+
+		return SMCResult_Continue;
+	}
+
+	SMCResult ReadSMC_LeavingSection(const SMCStates *states)
+	{
+		if(m_Depth == 2)
+			Compile();
+
+		m_Depth--;
+		return SMCResult_Continue;
+	}
+
+private:
+	const char *Find(const char *pKey) const
+	{
+		auto it = m_Keys.find(pKey);
+		return it == m_Keys.end() ? NULL : it->second.c_str();
+	}
+
+	void Error(const char *pError)
+	{
+		smutils->LogError(myself, "Output rule \"%s\" (%s:%u) skipped: %s", m_Name.c_str(), g_OutputRulesStats.Path.c_str(), m_Line, pError);
+		g_OutputRulesStats.Errors++;
+	}
+
+	void Compile()
+	{
+		const char *pOutput = Find("output");
+		if(pOutput == NULL || !pOutput[0])
+			return Error("missing \"output\"");
+
+		const char *pAction = Find("action");
+		OutputRuleAction Action;
+		if(pAction == NULL || !strcmp(pAction, "delete"))
+			Action = OutputRule_Delete;
+		else if(!strcmp(pAction, "modify"))
+			Action = OutputRule_Modify;
+		else if(!strcmp(pAction, "add"))
+			Action = OutputRule_Add;
+		else
+			return Error("\"action\" must be delete, modify or add");
+
+		const char *pDelay = Find("delay");
+		const char *pTimesToFire = Find("times");
+		std::unique_ptr<OutputRule> pRule(new OutputRule(Find("classname"), Find("targetname"), Find("target"), Find("input"), Find("parameter"),
+			pDelay ? atof(pDelay) : -1.0f, pTimesToFire ? atoi(pTimesToFire) : 0));
+
+		pRule->Name = m_Name;
+		pRule->Output = pOutput;
+		pRule->Action = Action;
+
+		const char *pValue;
+		if((pValue = Find("set_target")) != NULL)
+		{
+			pRule->iSetTarget = AllocOutputString(pValue);
+			pRule->SetFields |= OUTPUTRULE_SET_TARGET;
+		}
+		if((pValue = Find("set_input")) != NULL)
+		{
+			pRule->iSetTargetInput = AllocOutputString(pValue);
+			pRule->SetFields |= OUTPUTRULE_SET_TARGETINPUT;
+		}
+		if((pValue = Find("set_parameter")) != NULL)
+		{
+			pRule->iSetParameter = AllocOutputString(pValue);
+			pRule->SetFields |= OUTPUTRULE_SET_PARAMETER;
+		}
+		if((pValue = Find("set_delay")) != NULL)
+		{
+			pRule->flSetDelay = atof(pValue);
+			pRule->SetFields |= OUTPUTRULE_SET_DELAY;
+		}
+		if((pValue = Find("set_times")) != NULL)
+		{
+			pRule->nSetTimesToFire = atoi(pValue);
+			pRule->SetFields |= OUTPUTRULE_SET_TIMESTOFIRE;
+		}
+
+		if(Action == OutputRule_Modify && !pRule->SetFields)
+			return Error("modify needs at least one set_ key");
+
+		if(Action == OutputRule_Add)
+		{
+			if(!(pRule->SetFields & OUTPUTRULE_SET_TARGET) || !(pRule->SetFields & OUTPUTRULE_SET_TARGETINPUT))
+				return Error("add needs \"set_target\" and \"set_input\"");
+
+			if(!CEventAction::IsSupported())
+				return Error("creating actions is not supported on this game/platform");
+		}
+
+		// Resolved against the classes' outputs once they show up, see FindOutputRules.
+		g_OutputRulesByName[GetTargetKey(pOutput)].push_back(pRule.get());
+		g_OutputRules.push_back(std::move(pRule));
+	}
+
+	int m_Depth = 0;
+	std::string m_Name;
+	unsigned int m_Line = 0;
+	std::map<std::string, std::string> m_Keys;
+};
+
+/**
+ * Rules written for an output, by its Hammer name like the KeyValue detour
+ * resolves them or by its field name. Looked up once per output id.
+ */
+const std::vector<OutputRule *> &FindOutputRules(const OutputDesc &Desc)
+{
+	if(g_OutputRulesResolved.size() <= (size_t)Desc.OutputId)
+	{
+		g_OutputRulesResolved.resize(g_OutputNames.size());
+		g_OutputRulesByOutput.resize(g_OutputNames.size());
+	}
+
+	std::vector<OutputRule *> &Rules = g_OutputRulesByOutput[Desc.OutputId];
+	if(g_OutputRulesResolved[Desc.OutputId])
+		return Rules;
+
+	g_OutputRulesResolved[Desc.OutputId] = 1;
+
+	auto Add = [&](const char *pName)
+	{
+		auto it = g_OutputRulesByName.find(GetTargetKey(pName));
+		if(it == g_OutputRulesByName.end())
+			return;
+
+		for(OutputRule *pRule : it->second)
+		{
+			if(pRule->OutputId == -1)
+				pRule->OutputId = Desc.OutputId;
+			Rules.push_back(pRule);
+		}
+	};
+
+	Add(Desc.pTypeDesc->fieldName);
+	if(Desc.pTypeDesc->externalName && V_stricmp(Desc.pTypeDesc->externalName, Desc.pTypeDesc->fieldName))
+		Add(Desc.pTypeDesc->externalName);
+
+	return Rules;
+}
+
+/**
+ * Runs the rules indexed under each of the entity's outputs, returns the
+ * number of actions touched.
+ */
+int ApplyOutputRules(CBaseEntity *pEntity)
+{
+	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
+	if(!pMap)
 		return 0;
 
-	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
-	if(!pAction)
-		return 0;
+	std::vector<std::pair<int, OutputChange>> Changes;
+	string_t iClassname = NULL_STRING;
+	string_t iName = NULL_STRING;
+	bool bClassnameRead = false;
+	bool bNameRead = false;
+	int Touched = 0;
+
+	for(const OutputDesc &Desc : GetDataMapOutputs(pMap))
+	{
+		const std::vector<OutputRule *> &Rules = FindOutputRules(Desc);
+		if(Rules.empty())
+			continue;
+
+		CBaseEntityOutput *pEntityOutput = (CBaseEntityOutput *)((intptr_t)pEntity + Desc.Offset);
+		for(OutputRule *pRule : Rules)
+		{
+			// Only look the names up once a rule asks for them.
+			if(pRule->Classname.IsActive())
+			{
+				if(!bClassnameRead)
+				{
+					iClassname = MAKE_STRING(gamehelpers->GetEntityClassname(pEntity));
+					bClassnameRead = true;
+				}
+
+				if(!pRule->Classname.Matches(iClassname))
+					continue;
+			}
+
+			if(pRule->Targetname.IsActive())
+			{
+				if(!bNameRead)
+				{
+					iName = GetEntityTargetname(pEntity);
+					bNameRead = true;
+				}
+
+				if(!pRule->Targetname.Matches(iName))
+					continue;
+			}
+
+			int Count = pRule->Apply(pEntityOutput);
+			if(!Count)
+				continue;
+
+			pRule->Entities++;
+			pRule->Actions += Count;
+			Touched += Count;
+
+			OutputChange Change = pRule->Action == OutputRule_Delete ? OutputChange_Removed :
+				pRule->Action == OutputRule_Modify ? OutputChange_Modified : OutputChange_Added;
+			Changes.emplace_back(Desc.OutputId, Change);
+		}
+	}
+
+	if(Touched)
+	{
+		MarkEntityOutputsChanged(pEntity);
+		for(const auto &Change : Changes)
+			NotifyOutputChanged(pEntity, Change.first, Change.second);
+	}
+
+	return Touched;
+}
+
+void ApplyPendingOutputRules(bool simulating);
+
+void ApplyQueuedOutputRules()
+{
+	auto Start = std::chrono::steady_clock::now();
 
-	size_t Length;
-	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iTarget.ToCStr(), &Length);
+	// Applying rules can create entities, which queue up for the next frame.
+	std::vector<cell_t> Pending;
+	Pending.swap(g_PendingRuleEntities);
+	smutils->RemoveGameFrameHook(ApplyPendingOutputRules);
 
-	return Length;
+	for(cell_t EntityRef : Pending)
+	{
+		CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(EntityRef);
+		if(pEntity && ApplyOutputRules(pEntity))
+		{
+			if(g_bOutputRulesMapLoading)
+				g_OutputRulesStats.MapEntities++;
+			else
+				g_OutputRulesStats.LateEntities++;
+		}
+	}
+
+	g_OutputRulesStats.ApplyTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count();
 }
 
-cell_t GetOutputTargetInput(IPluginContext *pContext, const cell_t *params)
+void ApplyPendingOutputRules(bool simulating)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	ApplyQueuedOutputRules();
+}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return 0;
+/**
+ * New entities get their keyvalues after OnEntityCreated, they are handled on
+ * the next frame. While the map loads each entity's keyvalues are parsed
+ * right after it's created and everything spawns at the end, so the queued
+ * ones are complete once the next one comes and get their rules before spawning.
+ */
+void QueueOutputRules(CBaseEntity *pEntity)
+{
+	if(g_bOutputRulesMapLoading && !g_PendingRuleEntities.empty())
+		ApplyQueuedOutputRules();
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return 0;
+	if(g_PendingRuleEntities.empty())
+		smutils->AddGameFrameHook(ApplyPendingOutputRules);
 
-	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
-	if(!pAction)
-		return 0;
+	g_PendingRuleEntities.push_back(gamehelpers->EntityToReference(pEntity));
+}
 
-	size_t Length;
-	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iTargetInput.ToCStr(), &Length);
+void ClearOutputRules()
+{
+	if(!g_PendingRuleEntities.empty())
+	{
+		g_PendingRuleEntities.clear();
+		smutils->RemoveGameFrameHook(ApplyPendingOutputRules);
+	}
 
-	return Length;
+	g_OutputRules.clear();
+	g_OutputRulesByName.clear();
+	g_OutputRulesByOutput.clear();
+	g_OutputRulesResolved.clear();
+	g_bOutputRulesActive = false;
+	g_OutputRulesStats = OutputRulesStats();
 }
 
-cell_t GetOutputParameter(IPluginContext *pContext, const cell_t *params)
+/**
+ * Loads the current map's rules file and applies it to every existing entity.
+ * Returns false if there is no rules file for the map.
+ */
+bool LoadOutputRules()
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	ClearOutputRules();
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return 0;
+	const char *pMap = gamehelpers->GetCurrentMap();
+	if(pMap == NULL || !pMap[0])
+		return false;
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return 0;
+	g_bOutputRulesLoaded = true;
 
-	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
-	if(!pAction)
-		return 0;
+	char aPath[PLATFORM_MAX_PATH];
+	smutils->BuildPath(Path_SM, aPath, sizeof(aPath), "configs/outputinfo/maps/%s.cfg", pMap);
 
-	size_t Length;
-	pContext->StringToLocalUTF8(params[4], params[5], pAction->m_iParameter.ToCStr(), &Length);
+	g_OutputRulesStats.Path = aPath;
+	auto Start = std::chrono::steady_clock::now();
 
-	return Length;
+	OutputRulesParser Parser;
+	SMCStates States = { 0, 0 };
+	SMCError Error = textparsers->ParseFile_SMC(aPath, &Parser, &States);
+	if(Error != SMCError_Okay)
+	{
+		// Most maps have no rules file.
+		if(Error != SMCError_StreamOpen)
+			smutils->LogError(myself, "Failed to parse %s at line %u: %s", aPath, States.line, textparsers->GetSMCErrorString(Error));
+
+		ClearOutputRules();
+		return false;
+	}
+
+	auto Loaded = std::chrono::steady_clock::now();
+	g_OutputRulesStats.LoadTime = std::chrono::duration<double, std::micro>(Loaded - Start).count();
+
+	if(servertools != NULL)
+	{
+		for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+		{
+			if(ApplyOutputRules(pEntity))
+				g_OutputRulesStats.MapEntities++;
+		}
+	}
+
+	g_OutputRulesStats.ApplyTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Loaded).count();
+	g_bOutputRulesActive = !g_OutputRules.empty();
+
+	return true;
 }
 
-cell_t GetOutputDelay(IPluginContext *pContext, const cell_t *params)
+// Logs what the rules did to the map entities, once they all had their turn.
+void ReportOutputRules()
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	if(g_OutputRulesStats.Path.empty())
+		return;
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return 0;
+	const char *aPath = g_OutputRulesStats.Path.c_str();
+	int Actions = 0;
+	for(const auto &pRule : g_OutputRules)
+	{
+		Actions += pRule->Actions;
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return -1;
+		// Most likely a typo, entities spawned later still get checked.
+		if(pRule->OutputId == -1)
+			smutils->LogError(myself, "Output rule \"%s\" (%s): no entity on the map has an output \"%s\"",
+				pRule->Name.c_str(), aPath, pRule->Output.c_str());
+	}
 
-	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
-	if(!pAction)
+	smutils->LogMessage(myself, "Applied %d output rules from %s: %d actions on %d entities in %.2f ms (parsed in %.2f ms)",
+		(int)g_OutputRules.size(), aPath, Actions, g_OutputRulesStats.MapEntities,
+		g_OutputRulesStats.ApplyTime / 1000.0, g_OutputRulesStats.LoadTime / 1000.0);
+}
+
+const char *OutputRuleActionName(OutputRuleAction Action)
+{
+	return Action == OutputRule_Delete ? "delete" : Action == OutputRule_Modify ? "modify" : "add";
+}
+
+#define OUTPUTRULE_NAME			0	// char[64]
+#define OUTPUTRULE_OUTPUTID		16
+#define OUTPUTRULE_ACTION		17
+#define OUTPUTRULE_ENTITIES		18
+#define OUTPUTRULE_ACTIONS		19
+#define OUTPUTRULE_CELLS		20
+
+cell_t GetOutputRules(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], OUTPUTRULE_CELLS);
+	if(pArray == NULL)
 		return -1;
 
-	return *(cell_t *)&pAction->m_flDelay;
+	pArray->clear();
+
+	for(const auto &pRule : g_OutputRules)
+	{
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		ke::SafeStrcpy((char *)&pBlock[OUTPUTRULE_NAME], (OUTPUTRULE_OUTPUTID - OUTPUTRULE_NAME) * sizeof(cell_t), pRule->Name.c_str());
+		pBlock[OUTPUTRULE_OUTPUTID] = pRule->OutputId;
+		pBlock[OUTPUTRULE_ACTION] = pRule->Action;
+		pBlock[OUTPUTRULE_ENTITIES] = pRule->Entities;
+		pBlock[OUTPUTRULE_ACTIONS] = pRule->Actions;
+	}
+
+	cell_t *pLoadTime, *pApplyTime;
+	pContext->LocalToPhysAddr(params[2], &pLoadTime);
+	pContext->LocalToPhysAddr(params[3], &pApplyTime);
+	*pLoadTime = sp_ftoc((float)g_OutputRulesStats.LoadTime);
+	*pApplyTime = sp_ftoc((float)g_OutputRulesStats.ApplyTime);
+
+	return (cell_t)g_OutputRules.size();
 }
 
-cell_t GetOutputFormatted(IPluginContext *pContext, const cell_t *params)
+CON_COMMAND(sm_outputinfo_rules, "sm_outputinfo_rules [reload] - Report the current map's output rules, reload reads the file again and reapplies it")
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	if(args.ArgC() >= 2 && !strcmp(args.Arg(1), "reload"))
+	{
+		LoadOutputRules();
+		ReportOutputRules();
+	}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return 0;
+	if(g_OutputRulesStats.Path.empty())
+	{
+		META_CONPRINTF("[OutputInfo] No output rules loaded for this map.\n");
+		return;
+	}
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return 0;
+	META_CONPRINTF("[OutputInfo] %d rules from %s, %d errors.\n", (int)g_OutputRules.size(), g_OutputRulesStats.Path.c_str(), g_OutputRulesStats.Errors);
+	META_CONPRINTF("  parsed in %.2f ms, applied in %.2f ms to %d map entities and %d later ones\n",
+		g_OutputRulesStats.LoadTime / 1000.0, g_OutputRulesStats.ApplyTime / 1000.0,
+		g_OutputRulesStats.MapEntities, g_OutputRulesStats.LateEntities);
 
-	CEventAction *pAction = pEntityOutput->GetElement(params[3]);
-	if(!pAction)
+	META_CONPRINTF("%-32s %-24s %-8s %10s %10s\n", "Rule", "Output", "Action", "Entities", "Actions");
+	for(const auto &pRule : g_OutputRules)
+	{
+		META_CONPRINTF("%-32s %-24s %-8s %10d %10d\n", pRule->Name.c_str(), pRule->Output.c_str(),
+			OutputRuleActionName(pRule->Action), pRule->Entities, pRule->Actions);
+	}
+}
+
+/**
+ * Work handed off to a worker thread. Run() executes on the worker and must
+ * not touch game memory, Finish() is called on the game thread afterwards.
+ */
+class BackgroundJob
+{
+public:
+	virtual ~BackgroundJob() {}
+	virtual void Run() = 0;
+	virtual void Finish() = 0;
+
+	// Drop anything pointing into the plugin, Finish() may still be called.
+	virtual void OnPluginUnloaded(IPluginContext *pContext) {}
+
+public:
+	std::thread Thread;
+	std::atomic<bool> bDone{false};
+};
+
+std::vector<std::unique_ptr<BackgroundJob>> g_BackgroundJobs;
+
+void PollBackgroundJobs(bool simulating)
+{
+	for(size_t i = 0; i < g_BackgroundJobs.size(); )
+	{
+		BackgroundJob *pJob = g_BackgroundJobs[i].get();
+		if(!pJob->bDone)
+		{
+			i++;
+			continue;
+		}
+
+		pJob->Thread.join();
+		pJob->Finish();
+		g_BackgroundJobs.erase(g_BackgroundJobs.begin() + i);
+	}
+
+	if(g_BackgroundJobs.empty())
+		smutils->RemoveGameFrameHook(PollBackgroundJobs);
+}
+
+void StartBackgroundJob(BackgroundJob *pJob)
+{
+	if(g_BackgroundJobs.empty())
+		smutils->AddGameFrameHook(PollBackgroundJobs);
+
+	g_BackgroundJobs.emplace_back(pJob);
+	pJob->Thread = std::thread([pJob]()
+	{
+		pJob->Run();
+		pJob->bDone = true;
+	});
+}
+
+void JoinBackgroundJobs()
+{
+	if(g_BackgroundJobs.empty())
+		return;
+
+	// Nothing is left to report to on unload, just wait for the writes.
+	for(auto &pJob : g_BackgroundJobs)
+		pJob->Thread.join();
+
+	g_BackgroundJobs.clear();
+	smutils->RemoveGameFrameHook(PollBackgroundJobs);
+}
+
+/**
+ * Copies every entity into the graph in entity list order, unnamed ones too
+ * since actions can target them by classname. Outputs without actions are
+ * left out.
+ */
+void BuildOutputGraph(OutputGraph &Graph)
+{
+	for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+	{
+		Graph.AddEntity(gamehelpers->EntityToReference(pEntity), gamehelpers->GetEntityClassname(pEntity),
+			GetEntityTargetname(pEntity).ToCStr());
+
+		ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+		{
+			if(pEntityOutput->m_ActionList == NULL)
+				return;
+
+			Graph.AddOutput(pTypeDesc->fieldName);
+			for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
+			{
+				Graph.AddAction(ev->m_iTarget.ToCStr(), ev->m_iTargetInput.ToCStr(), ev->m_iParameter.ToCStr(),
+					ev->m_flDelay, ev->m_nTimesToFire);
+			}
+		});
+	}
+
+	Graph.Finish();
+}
+
+enum OutputGraphFormat
+{
+	OutputGraph_Json,
+	OutputGraph_Dot,
+	OutputGraph_Binary
+};
+
+class OutputGraphExportJob : public BackgroundJob
+{
+public:
+	OutputGraphExportJob(const char *pPath, OutputGraphFormat Format) :
+		m_Path(pPath), m_Format(Format), m_bSuccess(false)
+	{
+	}
+
+	void Run()
+	{
+		FILE *pFile = fopen(m_Path.c_str(), m_Format == OutputGraph_Binary ? "wb" : "w");
+		if(!pFile)
+			return;
+
+		switch(m_Format)
+		{
+		case OutputGraph_Json: m_bSuccess = m_Graph.WriteJson(pFile); break;
+		case OutputGraph_Dot: m_bSuccess = m_Graph.WriteDot(pFile); break;
+		case OutputGraph_Binary: m_bSuccess = m_Graph.WriteBinary(pFile); break;
+		}
+
+		m_bSuccess = (fclose(pFile) == 0) && m_bSuccess;
+	}
+
+	void Finish()
+	{
+		if(!m_bSuccess)
+		{
+			META_CONPRINTF("[OutputInfo] Failed to write \"%s\".\n", m_Path.c_str());
+			return;
+		}
+
+		META_CONPRINTF("[OutputInfo] Exported %d entities, %d outputs and %d actions to \"%s\".\n",
+			(int)m_Graph.EntityCount(), (int)m_Graph.OutputCount(), (int)m_Graph.ActionCount(), m_Path.c_str());
+	}
+
+public:
+	OutputGraph m_Graph;
+
+private:
+	std::string m_Path;
+	OutputGraphFormat m_Format;
+	bool m_bSuccess;
+};
+
+CON_COMMAND(sm_outputinfo_export, "sm_outputinfo_export <file> [json|dot|binary] - Write every entity's outputs to a file, relative to the game directory")
+{
+	if(args.ArgC() < 2)
+	{
+		META_CONPRINT("Usage: sm_outputinfo_export <file> [json|dot|binary]\n");
+		return;
+	}
+
+	OutputGraphFormat Format = OutputGraph_Json;
+	const char *pFormat = args.ArgC() >= 3 ? args.Arg(2) : "json";
+	if(!strcmp(pFormat, "dot"))
+		Format = OutputGraph_Dot;
+	else if(!strcmp(pFormat, "binary"))
+		Format = OutputGraph_Binary;
+	else if(strcmp(pFormat, "json"))
+	{
+		META_CONPRINTF("[OutputInfo] Unknown format \"%s\", expected json, dot or binary.\n", pFormat);
+		return;
+	}
+
+	if(servertools == NULL)
+		return;
+
+	char aPath[PLATFORM_MAX_PATH];
+	smutils->BuildPath(Path_Game, aPath, sizeof(aPath), "%s", args.Arg(1));
+
+	OutputGraphExportJob *pJob = new OutputGraphExportJob(aPath, Format);
+	BuildOutputGraph(pJob->m_Graph);
+	StartBackgroundJob(pJob);
+}
+
+/**
+ * Runs OutputGraph::Analyze on a snapshot of the map.
+ */
+class OutputGraphAnalysisJob : public BackgroundJob
+{
+public:
+	void Run()
+	{
+		m_Graph.Analyze(m_Analysis);
+	}
+
+	// Outputs sorted by worst case fan-out, largest first.
+	std::vector<uint32_t> SortedByFanout() const
+	{
+		std::vector<uint32_t> Outputs(m_Graph.OutputCount());
+		for(uint32_t i = 0; i < Outputs.size(); i++)
+			Outputs[i] = i;
+
+		std::stable_sort(Outputs.begin(), Outputs.end(), [this](uint32_t a, uint32_t b)
+		{
+			if(m_Analysis.OutputFanout[a] != m_Analysis.OutputFanout[b])
+				return m_Analysis.OutputFanout[a] > m_Analysis.OutputFanout[b];
+			return m_Analysis.OutputDirect[a] > m_Analysis.OutputDirect[b];
+		});
+
+		return Outputs;
+	}
+
+	const char *EntityName(uint32_t Entity, char *pBuffer, size_t Size) const
+	{
+		if(m_Graph.EntityName[Entity])
+			snprintf(pBuffer, Size, "%s (%s)", m_Graph.String(m_Graph.EntityName[Entity]), m_Graph.String(m_Graph.EntityClassname[Entity]));
+		else
+			snprintf(pBuffer, Size, "#%d (%s)", m_Graph.EntityRef[Entity], m_Graph.String(m_Graph.EntityClassname[Entity]));
+
+		return pBuffer;
+	}
+
+public:
+	OutputGraph m_Graph;
+	OutputGraphAnalysis m_Analysis;
+};
+
+class ConsoleAnalysisJob : public OutputGraphAnalysisJob
+{
+public:
+	ConsoleAnalysisJob(size_t Count) : m_Count(Count) {}
+
+	void Finish()
+	{
+		char aName[256];
+
+		META_CONPRINTF("[OutputInfo] %d zero-delay loops.\n", (int)m_Analysis.ZeroDelayCycles.size());
+		for(size_t i = 0; i < m_Analysis.ZeroDelayCycles.size(); i++)
+		{
+			META_CONPRINTF("  loop %d:", (int)i + 1);
+			for(uint32_t Entity : m_Analysis.ZeroDelayCycles[i])
+				META_CONPRINTF(" %s", EntityName(Entity, aName, sizeof(aName)));
+			META_CONPRINT("\n");
+		}
+
+		std::vector<uint32_t> Outputs = SortedByFanout();
+		size_t Count = std::min(m_Count, Outputs.size());
+
+		META_CONPRINTF("[OutputInfo] Top %d outputs by worst case fan-out:\n", (int)Count);
+		for(size_t i = 0; i < Count; i++)
+		{
+			uint32_t o = Outputs[i];
+			META_CONPRINTF("  %-48s %-24s direct %6u  total %10llu%s\n",
+				EntityName(m_Graph.OutputEntity[o], aName, sizeof(aName)), m_Graph.String(m_Graph.OutputName[o]),
+				m_Analysis.OutputDirect[o], (unsigned long long)m_Analysis.OutputFanout[o],
+				m_Analysis.OutputReachesLoop[o] ? "  (loops)" : "");
+		}
+	}
+
+private:
+	size_t m_Count;
+};
+
+#define CYCLE_CELLS 2
+#define FANOUT_ENTITY 0
+#define FANOUT_OUTPUTID 1
+#define FANOUT_DIRECT 2
+#define FANOUT_TOTAL 3
+#define FANOUT_LOOPS 4
+#define FANOUT_CELLS 5
+
+class PluginAnalysisJob : public OutputGraphAnalysisJob
+{
+public:
+	PluginAnalysisJob(IPluginContext *pContext, Handle_t hCycles, Handle_t hFanout, size_t MaxFanout, IPluginFunction *pCallback, cell_t Data) :
+		m_pContext(pContext), m_hCycles(hCycles), m_hFanout(hFanout), m_MaxFanout(MaxFanout), m_pCallback(pCallback), m_Data(Data)
+	{
+	}
+
+	void OnPluginUnloaded(IPluginContext *pContext)
+	{
+		if(pContext == m_pContext)
+			m_pCallback = NULL;
+	}
+
+	void Finish()
+	{
+		if(m_pCallback == NULL)
+			return;
+
+		// The plugin may have closed either list in the meantime.
+		HandleSecurity sec(m_pContext->GetIdentity(), myself->GetIdentity());
+		ICellArray *pCycles;
+		ICellArray *pFanout;
+		if(handlesys->ReadHandle(m_hCycles, g_CellArrayType, &sec, (void **)&pCycles) != HandleError_None ||
+			handlesys->ReadHandle(m_hFanout, g_CellArrayType, &sec, (void **)&pFanout) != HandleError_None)
+			return;
+
+		pCycles->clear();
+		for(size_t i = 0; i < m_Analysis.ZeroDelayCycles.size(); i++)
+		{
+			for(uint32_t Entity : m_Analysis.ZeroDelayCycles[i])
+			{
+				cell_t *pBlock = pCycles->push();
+				if(pBlock == NULL)
+					break;
+
+				pBlock[0] = (cell_t)i;
+				pBlock[1] = gamehelpers->ReferenceToBCompatRef(m_Graph.EntityRef[Entity]);
+			}
+		}
+
+		pFanout->clear();
+		std::vector<uint32_t> Outputs = SortedByFanout();
+		size_t Count = m_MaxFanout ? std::min(m_MaxFanout, Outputs.size()) : Outputs.size();
+		for(size_t i = 0; i < Count; i++)
+		{
+			uint32_t o = Outputs[i];
+			cell_t *pBlock = pFanout->push();
+			if(pBlock == NULL)
+				break;
+
+			pBlock[FANOUT_ENTITY] = gamehelpers->ReferenceToBCompatRef(m_Graph.EntityRef[m_Graph.OutputEntity[o]]);
+			pBlock[FANOUT_OUTPUTID] = InternOutputName(m_Graph.String(m_Graph.OutputName[o]));
+			pBlock[FANOUT_DIRECT] = (cell_t)m_Analysis.OutputDirect[o];
+			pBlock[FANOUT_TOTAL] = (cell_t)std::min<uint64_t>(m_Analysis.OutputFanout[o], 0x7FFFFFFF);
+			pBlock[FANOUT_LOOPS] = m_Analysis.OutputReachesLoop[o];
+		}
+
+		m_pCallback->PushCell(m_hCycles);
+		m_pCallback->PushCell(m_hFanout);
+		m_pCallback->PushCell(m_Data);
+		m_pCallback->Execute(NULL);
+	}
+
+private:
+	IPluginContext *m_pContext;
+	Handle_t m_hCycles;
+	Handle_t m_hFanout;
+	size_t m_MaxFanout;
+	IPluginFunction *m_pCallback;
+	cell_t m_Data;
+};
+
+CON_COMMAND(sm_outputinfo_analyze, "sm_outputinfo_analyze [count] - Report zero-delay output loops and the outputs with the largest fan-out")
+{
+	if(servertools == NULL)
+		return;
+
+	size_t Count = args.ArgC() >= 2 ? atoi(args.Arg(1)) : 20;
+
+	ConsoleAnalysisJob *pJob = new ConsoleAnalysisJob(Count);
+	BuildOutputGraph(pJob->m_Graph);
+	StartBackgroundJob(pJob);
+}
+
+cell_t AnalyzeOutputGraph(IPluginContext *pContext, const cell_t *params)
+{
+	if(servertools == NULL)
+		return pContext->ThrowNativeError("IServerTools interface not available");
+
+	if(GetCellArrayParam(pContext, params[1], CYCLE_CELLS) == NULL || GetCellArrayParam(pContext, params[2], FANOUT_CELLS) == NULL)
 		return 0;
 
-	char aBuffer[1024];
-	ke::SafeSprintf(aBuffer, sizeof(aBuffer), "%s,%s,%s,%g,%d",
-		pAction->m_iTarget.ToCStr(),
-		pAction->m_iTargetInput.ToCStr(),
-		pAction->m_iParameter.ToCStr(),
-		pAction->m_flDelay,
-		pAction->m_nTimesToFire);
+	if(params[3] < 0)
+		return pContext->ThrowNativeError("Invalid max fan-out count %d", params[3]);
 
-	size_t Length;
-	pContext->StringToLocalUTF8(params[4], params[5], aBuffer, &Length);
+	IPluginFunction *pCallback = pContext->GetFunctionById(params[4]);
+	if(pCallback == NULL)
+		return pContext->ThrowNativeError("Invalid callback function %x", params[4]);
 
-	return Length;
+	PluginAnalysisJob *pJob = new PluginAnalysisJob(pContext, params[1], params[2], params[3], pCallback, params[5]);
+	BuildOutputGraph(pJob->m_Graph);
+	StartBackgroundJob(pJob);
+
+	return 0;
 }
 
-cell_t GetOutputValue(IPluginContext *pContext, const cell_t *params)
+/**
+ * Memory report: every action reachable from an entity output, broken down
+ * per (classname, output), plus the game's CEventAction pool where known.
+ */
+struct ActionBreakdown
+{
+	int Entities;
+	int Actions;
+};
+
+struct ActionMemoryReport
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	int Live;
+	int PoolBlocks; // -1 if unknown
+	int FreeList; // -1 if unknown
+	std::map<std::pair<std::string, int>, ActionBreakdown> Breakdown; // (classname, output id)
+};
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+void BuildActionMemoryReport(ActionMemoryReport &Report)
+{
+	Report.Live = 0;
+	Report.PoolBlocks = -1;
+	Report.FreeList = -1;
+	Report.Breakdown.clear();
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL)
-		return -1;
+#ifdef PLATFORM_WINDOWS
+	if(CEventAction::s_pBlocksAllocated)
+		Report.PoolBlocks = *CEventAction::s_pBlocksAllocated;
 
-	switch(pEntityOutput->m_Value.fieldType)
+	if(CEventAction::s_ppHeadOfFreeList)
 	{
-	case FIELD_TICK:
-	case FIELD_MODELINDEX:
-	case FIELD_MATERIALINDEX:
-	case FIELD_INTEGER:
-	case FIELD_COLOR32:
-	case FIELD_SHORT:
-	case FIELD_CHARACTER:
-	case FIELD_BOOLEAN:
-		break;
-	default:
-		return pContext->ThrowNativeError("Entity '%s': %s value is not an integer (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+		// Capped in case the list isn't what we think it is.
+		Report.FreeList = 0;
+		for(void *pBlock = *CEventAction::s_ppHeadOfFreeList; pBlock != NULL && Report.FreeList < (1 << 24); pBlock = *(void **)pBlock)
+			Report.FreeList++;
 	}
+#endif
 
-	return (cell_t)pEntityOutput->m_Value.iVal;
+	if(servertools == NULL)
+		return;
+
+	for(CBaseEntity *pEntity = servertools->FirstEntity(); pEntity != NULL; pEntity = servertools->NextEntity(pEntity))
+	{
+		const char *pClassname = gamehelpers->GetEntityClassname(pEntity);
+		ForEachEntityOutput(pEntity, [&](typedescription_t *pTypeDesc, CBaseEntityOutput *pEntityOutput)
+		{
+			int Actions = pEntityOutput->NumberOfElements();
+			if(!Actions)
+				return;
+
+			ActionBreakdown &Row = Report.Breakdown[std::make_pair(std::string(pClassname ? pClassname : ""), InternOutputName(pTypeDesc->fieldName))];
+			Row.Entities++;
+			Row.Actions += Actions;
+			Report.Live += Actions;
+		});
+	}
 }
 
-cell_t GetOutputValueFloat(IPluginContext *pContext, const cell_t *params)
+std::vector<std::pair<const std::pair<std::string, int>, ActionBreakdown> *> SortActionBreakdown(ActionMemoryReport &Report)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	std::vector<std::pair<const std::pair<std::string, int>, ActionBreakdown> *> Sorted;
+	for(auto &Row : Report.Breakdown)
+		Sorted.push_back(&Row);
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
-
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL)
-		return -1;
-
-	switch(pEntityOutput->m_Value.fieldType)
+	std::stable_sort(Sorted.begin(), Sorted.end(), [](const std::pair<const std::pair<std::string, int>, ActionBreakdown> *a,
+		const std::pair<const std::pair<std::string, int>, ActionBreakdown> *b)
 	{
-	case FIELD_FLOAT:
-	case FIELD_TIME:
-		break;
-	default:
-		return pContext->ThrowNativeError("Entity '%s': %s value is not a float (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
-	}
+		return a->second.Actions > b->second.Actions;
+	});
 
-	return sp_ftoc((cell_t)pEntityOutput->m_Value.flVal);
+	return Sorted;
 }
 
-cell_t GetOutputValueString(IPluginContext *pContext, const cell_t *params)
+cell_t GetOutputMemoryStats(IPluginContext *pContext, const cell_t *params)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	ActionMemoryReport Report;
+	BuildActionMemoryReport(Report);
+
+	cell_t *pBytes, *pPoolBlocks, *pFreeList, *pCreated, *pFreed;
+	pContext->LocalToPhysAddr(params[1], &pBytes);
+	pContext->LocalToPhysAddr(params[2], &pPoolBlocks);
+	pContext->LocalToPhysAddr(params[3], &pFreeList);
+	pContext->LocalToPhysAddr(params[4], &pCreated);
+	pContext->LocalToPhysAddr(params[5], &pFreed);
+
+	*pBytes = Report.Live * (cell_t)sizeof(CEventAction);
+	*pPoolBlocks = Report.PoolBlocks;
+	*pFreeList = Report.FreeList;
+	*pCreated = (cell_t)CEventAction::s_nCreated;
+	*pFreed = (cell_t)CEventAction::s_nFreed;
+
+	return Report.Live;
+}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+#define BREAKDOWN_CLASSNAME		0	// char[64]
+#define BREAKDOWN_OUTPUTID		16
+#define BREAKDOWN_ENTITIES		17
+#define BREAKDOWN_ACTIONS		18
+#define BREAKDOWN_CELLS			19
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL)
+cell_t GetOutputActionBreakdown(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], BREAKDOWN_CELLS);
+	if(pArray == NULL)
 		return -1;
 
-	switch(pEntityOutput->m_Value.fieldType)
+	pArray->clear();
+
+	ActionMemoryReport Report;
+	BuildActionMemoryReport(Report);
+
+	for(auto *pRow : SortActionBreakdown(Report))
 	{
-	case FIELD_CHARACTER:
-	case FIELD_STRING:
-	case FIELD_MODELNAME:
-	case FIELD_SOUNDNAME:
-		break;
-	default:
-		return pContext->ThrowNativeError("Entity '%s': %s value is not a string (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
-		
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		ke::SafeStrcpy((char *)&pBlock[BREAKDOWN_CLASSNAME], (BREAKDOWN_OUTPUTID - BREAKDOWN_CLASSNAME) * sizeof(cell_t), pRow->first.first.c_str());
+		pBlock[BREAKDOWN_OUTPUTID] = pRow->first.second;
+		pBlock[BREAKDOWN_ENTITIES] = pRow->second.Entities;
+		pBlock[BREAKDOWN_ACTIONS] = pRow->second.Actions;
 	}
 
-	size_t len;
-	pContext->StringToLocalUTF8(params[3], params[4], pEntityOutput->m_Value.iszVal.ToCStr(), &len);
-
-	return len;
+	return Report.Live;
 }
 
-cell_t GetOutputValueVector(IPluginContext *pContext, const cell_t *params)
+CON_COMMAND(sm_outputinfo_memory, "sm_outputinfo_memory [count] - Report CEventAction memory use and the outputs holding the most actions")
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	size_t Count = args.ArgC() >= 2 ? atoi(args.Arg(1)) : 20;
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+	ActionMemoryReport Report;
+	BuildActionMemoryReport(Report);
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL)
-		return -1;
+	META_CONPRINTF("[OutputInfo] %d live actions, about %d bytes.\n", Report.Live, Report.Live * (int)sizeof(CEventAction));
+	if(Report.PoolBlocks != -1)
+		META_CONPRINTF("  pool: %d blocks allocated, %d on the free list\n", Report.PoolBlocks, Report.FreeList);
+	META_CONPRINTF("  created by OutputInfo: %llu, freed by OutputInfo: %llu\n",
+		(unsigned long long)CEventAction::s_nCreated, (unsigned long long)CEventAction::s_nFreed);
 
-	switch(pEntityOutput->m_Value.fieldType)
+	auto Sorted = SortActionBreakdown(Report);
+	META_CONPRINTF("%-40s %-32s %10s %10s\n", "Classname", "Output", "Entities", "Actions");
+	for(size_t i = 0; i < Sorted.size() && i < Count; i++)
 	{
-	case FIELD_FLOAT:
-	case FIELD_TIME:
-		break;
-	default:
-		return pContext->ThrowNativeError("Entity '%s': %s value is not a float (%d)", GetEntityName(pEntity), pOutput, pEntityOutput->m_Value.fieldType);
+		META_CONPRINTF("%-40s %-32s %10d %10d\n", Sorted[i]->first.first.c_str(), OutputIdToName(Sorted[i]->first.second),
+			Sorted[i]->second.Entities, Sorted[i]->second.Actions);
 	}
+}
 
-	cell_t *vec;
-	pContext->LocalToPhysAddr(params[3], &vec);
+/**
+ * Optional per native instrumentation. Every native is registered through a
+ * trampoline that just forwards to it, and while enabled counts calls,
+ * failures and a log2 latency histogram.
+ */
+#define NATIVESTATS_BUCKETS		24	// bucket i counts calls taking [2^i, 2^(i+1)) ns, the last one everything longer
+#define NATIVESTATS_MAX			256
 
-	vec[0] = sp_ftoc(pEntityOutput->m_Value.vecVal[0]);
-	vec[1] = sp_ftoc(pEntityOutput->m_Value.vecVal[1]);
-	vec[2] = sp_ftoc(pEntityOutput->m_Value.vecVal[2]);
+struct NativeStats
+{
+	const char *pName;
+	SPVM_NATIVE_FUNC pFunc;
+	uint64_t Calls;
+	uint64_t Errors;
+	uint64_t Nanoseconds;
+	uint64_t Histogram[NATIVESTATS_BUCKETS];
+};
 
-	return 1;
-}
+NativeStats g_NativeStats[NATIVESTATS_MAX];
+size_t g_nNativeStats = 0;
+bool g_bNativeStatsEnabled = false;
 
-cell_t FindOutput(IPluginContext *pContext, const cell_t *params)
+cell_t CallInstrumentedNative(NativeStats &Stats, IPluginContext *pContext, const cell_t *params)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
-
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+	unsigned int Failures = g_NativeFailures;
+	auto Start = std::chrono::steady_clock::now();
+	cell_t Result = Stats.pFunc(pContext, params);
+	uint64_t Nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return -1;
+	int Bucket = 0;
+	for(uint64_t n = Nanoseconds >> 1; n && Bucket < NATIVESTATS_BUCKETS - 1; n >>= 1)
+		Bucket++;
 
-	char *piTarget;
-	pContext->LocalToStringNULL(params[4], &piTarget);
-	char *piTargetInput;
-	pContext->LocalToStringNULL(params[5], &piTargetInput);
-	char *piParameter;
-	pContext->LocalToStringNULL(params[6], &piParameter);
-	float flDelay = *(float *)&params[7];
-	cell_t nTimesToFire = params[8];
+	Stats.Calls++;
+	Stats.Nanoseconds += Nanoseconds;
+	Stats.Histogram[Bucket]++;
 
-	int StartCount = params[3];
-	int Count = 0;
-	for(CEventAction *ev = pEntityOutput->m_ActionList; ev != NULL; ev = ev->m_pNext)
-	{
-		Count++;
-		if(StartCount > 0)
-		{
-			StartCount--;
-			continue;
-		}
+	if(g_NativeFailures != Failures || pContext->GetLastNativeError() != SP_ERROR_NONE)
+		Stats.Errors++;
 
-		if(piTarget != NULL && strcmp(ev->m_iTarget.ToCStr(), piTarget) != 0)
-			continue;
+	return Result;
+}
 
-		if(piTargetInput != NULL && strcmp(ev->m_iTargetInput.ToCStr(), piTargetInput) != 0)
-			continue;
+template <size_t I>
+cell_t NativeTrampoline(IPluginContext *pContext, const cell_t *params)
+{
+	if(!g_bNativeStatsEnabled)
+		return g_NativeStats[I].pFunc(pContext, params);
 
-		if(piParameter != NULL && strcmp(ev->m_iParameter.ToCStr(), piParameter) != 0)
-			continue;
+	return CallInstrumentedNative(g_NativeStats[I], pContext, params);
+}
 
-		if(flDelay >= 0 && flDelay != ev->m_flDelay)
-			continue;
+template <size_t... I>
+std::array<SPVM_NATIVE_FUNC, sizeof...(I)> MakeNativeTrampolines(std::index_sequence<I...>)
+{
+	return {{ NativeTrampoline<I>... }};
+}
 
-		if(nTimesToFire != 0 && nTimesToFire != ev->m_nTimesToFire)
-			continue;
+/**
+ * Returns a copy of pNatives with every function routed through its trampoline.
+ */
+const sp_nativeinfo_t *InstrumentNatives(const sp_nativeinfo_t *pNatives)
+{
+	static const std::array<SPVM_NATIVE_FUNC, NATIVESTATS_MAX> s_Trampolines = MakeNativeTrampolines(std::make_index_sequence<NATIVESTATS_MAX>());
+	static sp_nativeinfo_t s_Natives[NATIVESTATS_MAX + 1];
 
-		return Count - 1;
+	size_t i;
+	for(i = 0; pNatives[i].name != NULL && i < NATIVESTATS_MAX; i++)
+	{
+		g_NativeStats[i].pName = pNatives[i].name;
+		g_NativeStats[i].pFunc = pNatives[i].func;
+		s_Natives[i].name = pNatives[i].name;
+		s_Natives[i].func = s_Trampolines[i];
 	}
 
-	return -1;
+	// Out of trampolines, bump NATIVESTATS_MAX.
+	if(pNatives[i].name != NULL)
+		return pNatives;
+
+	g_nNativeStats = i;
+	s_Natives[i].name = NULL;
+	s_Natives[i].func = NULL;
+	return s_Natives;
 }
 
-cell_t DeleteOutput(IPluginContext *pContext, const cell_t *params)
+void ClearNativeStats()
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	for(size_t i = 0; i < g_nNativeStats; i++)
+	{
+		NativeStats &Stats = g_NativeStats[i];
+		Stats.Calls = 0;
+		Stats.Errors = 0;
+		Stats.Nanoseconds = 0;
+		memset(Stats.Histogram, 0, sizeof(Stats.Histogram));
+	}
+}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+// Natives that were called, most total time first.
+std::vector<const NativeStats *> SortNativeStats()
+{
+	std::vector<const NativeStats *> Sorted;
+	for(size_t i = 0; i < g_nNativeStats; i++)
+	{
+		if(g_NativeStats[i].Calls)
+			Sorted.push_back(&g_NativeStats[i]);
+	}
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return -1;
+	std::sort(Sorted.begin(), Sorted.end(), [](const NativeStats *a, const NativeStats *b)
+	{
+		return a->Nanoseconds > b->Nanoseconds;
+	});
 
-	return pEntityOutput->DeleteElement(params[3]);
+	return Sorted;
 }
 
-cell_t DeleteAllOutputs(IPluginContext *pContext, const cell_t *params)
+// Upper bound of the bucket the given fraction of calls falls into, in ns.
+uint64_t NativeStatsPercentile(const NativeStats &Stats, double Fraction)
 {
-	char *pOutput;
-	pContext->LocalToString(params[2], &pOutput);
+	uint64_t Rank = (uint64_t)(Stats.Calls * Fraction);
+	uint64_t Seen = 0;
+	for(int i = 0; i < NATIVESTATS_BUCKETS; i++)
+	{
+		Seen += Stats.Histogram[i];
+		if(Seen > Rank)
+			return (uint64_t)2 << i;
+	}
 
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+	return (uint64_t)2 << (NATIVESTATS_BUCKETS - 1);
+}
 
-	CBaseEntityOutput *pEntityOutput = GetOutput(pEntity, pOutput);
-	if(pEntityOutput == NULL || pEntityOutput->m_ActionList == NULL)
-		return -1;
+#define NATIVESTATS_NAME		0	// char[64]
+#define NATIVESTATS_CALLS		16
+#define NATIVESTATS_ERRORS		17
+#define NATIVESTATS_TIME		18
+#define NATIVESTATS_HISTOGRAM	19	// int[NATIVESTATS_BUCKETS]
+#define NATIVESTATS_CELLS		(NATIVESTATS_HISTOGRAM + NATIVESTATS_BUCKETS)
 
-	return pEntityOutput->DeleteAllElements();
+cell_t SetNativeStatsEnabled(IPluginContext *pContext, const cell_t *params)
+{
+	g_bNativeStatsEnabled = params[1] != 0;
+	return 0;
 }
 
-cell_t GetOutputNames(IPluginContext *pContext, const cell_t *params)
+cell_t ResetNativeStats(IPluginContext *pContext, const cell_t *params)
 {
-	CBaseEntity *pEntity = gamehelpers->ReferenceToEntity(gamehelpers->IndexToReference(params[1]));
-	if(!pEntity)
-		return -1;
+	ClearNativeStats();
+	return 0;
+}
 
-	datamap_t *pMap = gamehelpers->GetDataMap(pEntity);
-	if(!pMap)
+cell_t GetNativeStats(IPluginContext *pContext, const cell_t *params)
+{
+	ICellArray *pArray = GetCellArrayParam(pContext, params[1], NATIVESTATS_CELLS);
+	if(pArray == NULL)
 		return -1;
 
-	for(int count = 0; pMap != NULL; pMap = pMap->baseMap)
+	pArray->clear();
+
+	std::vector<const NativeStats *> Sorted = SortNativeStats();
+	for(const NativeStats *pStats : Sorted)
 	{
-		for(int i = 0; i < pMap->dataNumFields; i++)
-		{
-			typedescription_t *pTypeDesc = &pMap->dataDesc[i];
+		cell_t *pBlock = pArray->push();
+		if(pBlock == NULL)
+			return pContext->ThrowNativeError("Failed to grow ArrayList");
+
+		ke::SafeStrcpy((char *)&pBlock[NATIVESTATS_NAME], (NATIVESTATS_CALLS - NATIVESTATS_NAME) * sizeof(cell_t), pStats->pName);
+		pBlock[NATIVESTATS_CALLS] = (cell_t)pStats->Calls;
+		pBlock[NATIVESTATS_ERRORS] = (cell_t)pStats->Errors;
+		pBlock[NATIVESTATS_TIME] = sp_ftoc((float)(pStats->Nanoseconds / 1000.0));
+		for(int i = 0; i < NATIVESTATS_BUCKETS; i++)
+			pBlock[NATIVESTATS_HISTOGRAM + i] = (cell_t)pStats->Histogram[i];
+	}
 
-			if(pTypeDesc->fieldType != FIELD_CUSTOM)
-				continue;
+	return (cell_t)Sorted.size();
+}
 
-			if(!(pTypeDesc->flags & FTYPEDESC_OUTPUT))
-				continue;
+CON_COMMAND(sm_outputinfo_stats, "sm_outputinfo_stats <on|off|reset|top [count]> - Count calls and time spent per native")
+{
+	const char *pCmd = args.ArgC() >= 2 ? args.Arg(1) : "";
 
-			if(params[2] == count)
-			{
-				size_t len;
-				pContext->StringToLocalUTF8(params[3], params[4], pTypeDesc->fieldName, &len);
-				return len;
-			}
+	if(!strcmp(pCmd, "on") || !strcmp(pCmd, "off"))
+	{
+		g_bNativeStatsEnabled = pCmd[1] == 'n';
+		META_CONPRINTF("[OutputInfo] Native stats %s.\n", g_bNativeStatsEnabled ? "enabled" : "disabled");
+	}
+	else if(!strcmp(pCmd, "reset"))
+	{
+		ClearNativeStats();
+	}
+	else if(!strcmp(pCmd, "top"))
+	{
+		size_t Count = args.ArgC() >= 3 ? atoi(args.Arg(2)) : 20;
+		std::vector<const NativeStats *> Sorted = SortNativeStats();
 
-			count++;
+		META_CONPRINTF("%-40s %10s %8s %12s %10s %10s %10s\n", "Native", "Calls", "Errors", "Total (ms)", "Avg (us)", "p50 (us)", "p99 (us)");
+		for(size_t i = 0; i < Sorted.size() && i < Count; i++)
+		{
+			const NativeStats *pStats = Sorted[i];
+			META_CONPRINTF("%-40s %10llu %8llu %12.3f %10.3f %10.3f %10.3f\n", pStats->pName,
+				(unsigned long long)pStats->Calls, (unsigned long long)pStats->Errors,
+				pStats->Nanoseconds / 1000000.0, pStats->Nanoseconds / 1000.0 / pStats->Calls,
+				NativeStatsPercentile(*pStats, 0.5) / 1000.0, NativeStatsPercentile(*pStats, 0.99) / 1000.0);
 		}
 	}
-
-	return -1;
+	else
+	{
+		META_CONPRINTF("Usage: sm_outputinfo_stats <on|off|reset|top [count]> (stats are %s)\n",
+			g_bNativeStatsEnabled ? "enabled" : "disabled");
+	}
 }
 
 const sp_nativeinfo_t MyNatives[] =
@@ -647,11 +6180,113 @@ const sp_nativeinfo_t MyNatives[] =
 	{ "DeleteOutput", DeleteOutput },
 	{ "DeleteAllOutputs", DeleteAllOutputs },
 	{ "GetOutputNames", GetOutputNames },
+	{ "GetOutputNameCount", GetOutputNameCount },
+	{ "GetEntityOutputs", GetEntityOutputs },
+	{ "ResolveOutputId", ResolveOutputId },
+	{ "GetOutputCountById", GetOutputCountById },
+	{ "GetOutputTargetById", GetOutputTargetById },
+	{ "GetOutputTargetInputById", GetOutputTargetInputById },
+	{ "GetOutputParameterById", GetOutputParameterById },
+	{ "GetOutputDelayById", GetOutputDelayById },
+	{ "GetOutputFormattedById", GetOutputFormattedById },
+	{ "GetOutputValueById", GetOutputValueById },
+	{ "GetOutputValueFloatById", GetOutputValueFloatById },
+	{ "GetOutputValueStringById", GetOutputValueStringById },
+	{ "GetOutputValueVectorById", GetOutputValueVectorById },
+	{ "FindOutputById", FindOutputById },
+	{ "DeleteOutputById", DeleteOutputById },
+	{ "DeleteAllOutputsById", DeleteAllOutputsById },
+	{ "GetOutputActions", GetOutputActions },
+	{ "GetOutputActionsById", GetOutputActionsById },
+	{ "OutputIterator.OutputIterator", OutputIterator_OutputIterator },
+	{ "CreateOutputIteratorById", OutputIterator_OutputIteratorById },
+	{ "OutputIterator.Next", OutputIterator_Next },
+	{ "OutputIterator.Reset", OutputIterator_Reset },
+	{ "OutputIterator.DeleteCurrent", OutputIterator_DeleteCurrent },
+	{ "OutputIterator.Index.get", OutputIterator_IndexGet },
+	{ "OutputIterator.GetTarget", OutputIterator_GetTarget },
+	{ "OutputIterator.GetTargetInput", OutputIterator_GetTargetInput },
+	{ "OutputIterator.GetParameter", OutputIterator_GetParameter },
+	{ "OutputIterator.Delay.get", OutputIterator_DelayGet },
+	{ "OutputIterator.TimesToFire.get", OutputIterator_TimesToFireGet },
+	{ "OutputIterator.IDStamp.get", OutputIterator_IDStampGet },
+	{ "OutputIterator.GetAction", OutputIterator_GetAction },
+	{ "FindOutputsTargeting", FindOutputsTargeting },
+	{ "ResolveOutputTargets", ResolveOutputTargets },
+	{ "ResolveOutputTargetsById", ResolveOutputTargetsById },
+	{ "DeleteOutputsMatching", DeleteOutputsMatching },
+	{ "DeleteOutputsMatchingById", DeleteOutputsMatchingById },
+	{ "DeleteEntityOutputsMatching", DeleteEntityOutputsMatching },
+	{ "GetOutputCountBatch", GetOutputCountBatch },
+	{ "GetOutputCountBatchById", GetOutputCountBatchById },
+	{ "FindOutputBatch", FindOutputBatch },
+	{ "FindOutputBatchById", FindOutputBatchById },
+	{ "DeleteOutputsMatchingBatch", DeleteOutputsMatchingBatch },
+	{ "DeleteOutputsMatchingBatchById", DeleteOutputsMatchingBatchById },
+	{ "CompactOutputActions", CompactOutputActions },
+	{ "CompactOutputActionsById", CompactOutputActionsById },
+	{ "OutputFilter.OutputFilter", OutputFilter_OutputFilter },
+	{ "FindOutputFiltered", FindOutputFiltered },
+	{ "FindOutputFilteredById", FindOutputFilteredById },
+	{ "DeleteOutputsFiltered", DeleteOutputsFiltered },
+	{ "DeleteOutputsFilteredById", DeleteOutputsFilteredById },
+	{ "DeleteEntityOutputsFiltered", DeleteEntityOutputsFiltered },
+	{ "InsertOutputAction", InsertOutputAction },
+	{ "InsertOutputActionById", InsertOutputActionById },
+	{ "CopyOutputs", CopyOutputs },
+	{ "CopyOutputsById", CopyOutputsById },
+	{ "MoveOutputs", MoveOutputs },
+	{ "MoveOutputsById", MoveOutputsById },
+	{ "SetOutputTarget", SetOutputTarget },
+	{ "SetOutputTargetById", SetOutputTargetById },
+	{ "SetOutputTargetInput", SetOutputTargetInput },
+	{ "SetOutputTargetInputById", SetOutputTargetInputById },
+	{ "SetOutputParameter", SetOutputParameter },
+	{ "SetOutputParameterById", SetOutputParameterById },
+	{ "SetOutputDelay", SetOutputDelay },
+	{ "SetOutputDelayById", SetOutputDelayById },
+	{ "SetOutputTimesToFire", SetOutputTimesToFire },
+	{ "SetOutputTimesToFireById", SetOutputTimesToFireById },
+	{ "GetOutputIdName", GetOutputIdName },
+	{ "GetEventQueueCount", GetEventQueueCount },
+	{ "GetEventQueueEvents", GetEventQueueEvents },
+	{ "CancelEventsByTarget", CancelEventsByTarget },
+	{ "CancelEventsByCaller", CancelEventsByCaller },
+	{ "CancelEventsFiltered", CancelEventsFiltered },
+	{ "SetOutputTraceEnabled", SetOutputTraceEnabled },
+	{ "IsOutputTraceEnabled", IsOutputTraceEnabled },
+	{ "DrainOutputTrace", DrainOutputTrace },
+	{ "SetOutputChainTraceEnabled", SetOutputChainTraceEnabled },
+	{ "IsOutputChainTraceEnabled", IsOutputChainTraceEnabled },
+	{ "GetOutputChains", GetOutputChains },
+	{ "SetOutputProfileEnabled", SetOutputProfileEnabled },
+	{ "ResetOutputProfile", ResetOutputProfile },
+	{ "GetOutputProfile", GetOutputProfile },
+	{ "AnalyzeOutputGraph", AnalyzeOutputGraph },
+	{ "SetOutputRateLimit", SetOutputRateLimit },
+	{ "SetOutputClassRateLimit", SetOutputClassRateLimit },
+	{ "GetOutputRateLimit", GetOutputRateLimit },
+	{ "GetOutputRateLimitStats", GetOutputRateLimitStats },
+	{ "ClearOutputRateLimits", ClearOutputRateLimits },
+	{ "SubscribeOutputChanges", SubscribeOutputChanges },
+	{ "UnsubscribeOutputChanges", UnsubscribeOutputChanges },
+	{ "WatchOutputValue", WatchOutputValue },
+	{ "WatchOutputValueById", WatchOutputValueById },
+	{ "UnwatchOutputValue", UnwatchOutputValue },
+	{ "UnwatchOutputValueById", UnwatchOutputValueById },
+	{ "GetOutputMemoryStats", GetOutputMemoryStats },
+	{ "GetOutputActionBreakdown", GetOutputActionBreakdown },
+	{ "SetNativeStatsEnabled", SetNativeStatsEnabled },
+	{ "ResetNativeStats", ResetNativeStats },
+	{ "GetNativeStats", GetNativeStats },
+	{ "GetOutputRules", GetOutputRules },
 	{ NULL, NULL },
 };
 
 bool Outputinfo::SDK_OnLoad(char *error, size_t maxlen, bool late)
 {
+	g_bLateLoad = late;
+
 	char conf_error[255] = "";
 	if(!gameconfs->LoadGameConfigFile("outputinfo.games", &g_pGameConf, conf_error, sizeof(conf_error)))
 	{
@@ -689,17 +6324,223 @@ bool Outputinfo::SDK_OnLoad(char *error, size_t maxlen, bool late)
 		snprintf(error, maxlen, "Failed to find CEventAction__operator_delete function.\n");
 		return false;
 	}
+
+	// Optional, only needed to create new actions.
+	g_pGameConf->GetMemSig("CEventAction__operator_new", (void **)(&CEventAction::s_pOperatorNewFunc));
 #endif
 
+	// Optional, creating actions is disabled without it.
+	g_pGameConf->GetMemSig("CEventAction__s_iNextIDStamp", (void **)(&CEventAction::s_piNextIDStamp));
+	g_pGameConf->GetMemSig("AllocPooledString", (void **)(&g_pAllocPooledString));
+	g_pGameConf->GetMemSig("g_EventQueue", (void **)(&g_pEventQueue));
+	g_pGameConf->GetMemSig("EventQueuePrioritizedEvent_t__operator_delete", (void **)(&EventQueuePrioritizedEvent_t::s_pOperatorDeleteFunc));
+
+	HandleError err;
+	g_OutputIteratorType = handlesys->CreateType("OutputIterator", this, 0, NULL, NULL, myself->GetIdentity(), &err);
+	if(!g_OutputIteratorType)
+	{
+		snprintf(error, maxlen, "Failed to create OutputIterator handle type (error %d).\n", err);
+		return false;
+	}
+
+	g_OutputFilterType = handlesys->CreateType("OutputFilter", this, 0, NULL, NULL, myself->GetIdentity(), &err);
+	if(!g_OutputFilterType)
+	{
+		snprintf(error, maxlen, "Failed to create OutputFilter handle type (error %d).\n", err);
+		return false;
+	}
+
+	sharesys->AddDependency(myself, "sdkhooks.ext", false, true);
+
+	CDetourManager::Init(smutils->GetScriptingEngine(), g_pGameConf);
+
+	// Optional, everything built on top of it reports when it's missing.
+	g_pFireOutputDetour = DETOUR_CREATE_MEMBER(CBaseEntityOutput_FireOutput, "CBaseEntityOutput__FireOutput");
+
+	// Keeps the target index in sync with AddOutput and raises OutputChange_Added, optional as well.
+	g_pKeyValueDetour = DETOUR_CREATE_MEMBER(CBaseEntity_KeyValue, "CBaseEntity__KeyValue");
+	if(g_pKeyValueDetour)
+		g_pKeyValueDetour->EnableDetour();
+
+	// Only enabled while chain tracing is on.
+	g_pAcceptInputDetour = DETOUR_CREATE_MEMBER(CBaseEntity_AcceptInput, "CBaseEntity__AcceptInput");
+
+	plsys->AddPluginsListener(this);
+
+	return true;
+}
+
+bool Outputinfo::SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlen, bool late)
+{
+	GET_V_IFACE_ANY(GetServerFactory, servertools, IServerTools, VSERVERTOOLS_INTERFACE_VERSION);
+	GET_V_IFACE_CURRENT(GetEngineFactory, icvar, ICvar, CVAR_INTERFACE_VERSION);
+
+	gpGlobals = ismm->GetCGlobals();
+
+	g_pCVar = icvar;
+	ConVar_Register(0, this);
+
 	return true;
 }
 
+bool Outputinfo::RegisterConCommandBase(ConCommandBase *pCommand)
+{
+	return META_REGCVAR(pCommand);
+}
+
 void Outputinfo::SDK_OnUnload()
 {
+	plsys->RemovePluginsListener(this);
+	JoinBackgroundJobs();
+	EnableOutputChains(false);
+	ClearOutputRules();
+
+	if(g_pFireOutputDetour)
+	{
+		g_pFireOutputDetour->Destroy();
+		g_pFireOutputDetour = NULL;
+	}
+
+	if(g_pKeyValueDetour)
+	{
+		g_pKeyValueDetour->Destroy();
+		g_pKeyValueDetour = NULL;
+	}
+
+	if(g_pAcceptInputDetour)
+	{
+		g_pAcceptInputDetour->Destroy();
+		g_pAcceptInputDetour = NULL;
+	}
+
+	ConVar_Unregister();
+
+	if(g_pSDKHooks)
+		g_pSDKHooks->RemoveEntityListener(this);
+
+	handlesys->RemoveType(g_OutputFilterType, myself->GetIdentity());
+	handlesys->RemoveType(g_OutputIteratorType, myself->GetIdentity());
 	gameconfs->CloseGameConfigFile(g_pGameConf);
 }
 
+void Outputinfo::OnPluginUnloaded(IPlugin *plugin)
+{
+	for(auto &pJob : g_BackgroundJobs)
+		pJob->OnPluginUnloaded(plugin->GetBaseContext());
+
+	if(!g_OutputSubscriptions.empty())
+		RemoveOutputSubscriptions(plugin->GetBaseContext(), NULL);
+
+	if(!g_OutputValueWatches.empty())
+		RemoveOutputValueWatches(plugin->GetBaseContext(), 0);
+}
+
+void Outputinfo::OnHandleDestroy(HandleType_t type, void *object)
+{
+	if(type == g_OutputIteratorType)
+		delete (OutputIterator *)object;
+	else if(type == g_OutputFilterType)
+		delete (OutputFilter *)object;
+}
+
 void Outputinfo::SDK_OnAllLoaded()
 {
-	sharesys->AddNatives(myself, MyNatives);
+	sharesys->AddNatives(myself, InstrumentNatives(MyNatives));
+
+	handlesys->FindHandleType("CellArray", &g_CellArrayType);
+
+	SM_GET_LATE_IFACE(SDKHOOKS, g_pSDKHooks);
+	if(g_pSDKHooks)
+		g_pSDKHooks->AddEntityListener(this);
+
+	if(g_bLateLoad)
+	{
+		LoadOutputRules();
+		ReportOutputRules();
+		RebuildTargetIndex();
+		RebuildNameIndex();
+	}
+}
+
+void Outputinfo::NotifyInterfaceDrop(SMInterface *pInterface)
+{
+	if(strcmp(pInterface->GetInterfaceName(), SMINTERFACE_SDKHOOKS_NAME) == 0)
+		g_pSDKHooks = NULL;
+}
+
+void Outputinfo::OnCoreMapStart(edict_t *pEdictList, int edictCount, int clientMax)
+{
+	// Without SDKHooks nothing loaded the rules while the map was created,
+	// they get one pass over the spawned entities instead.
+	if(!g_bOutputRulesLoaded)
+		LoadOutputRules();
+	else if(!g_PendingRuleEntities.empty())
+		ApplyQueuedOutputRules();
+
+	g_bOutputRulesMapLoading = false;
+	ReportOutputRules();
+
+	RebuildTargetIndex();
+	RebuildNameIndex();
+}
+
+void Outputinfo::OnCoreMapEnd()
+{
+	InvalidateTargetIndex();
+	InvalidateNameIndex();
+	g_StringPoolEpoch++;
+
+	// Class rows are keyed by pooled classname pointers, which die with the map.
+	ClearOutputProfile();
+	g_ClassRateLimitCache.clear();
+
+	// Game time restarts with the next map.
+	ClearOutputChains(true);
+
+	// Rules and the strings they pooled belong to the map.
+	ClearOutputRules();
+	g_bOutputRulesLoaded = false;
+
+	if(!g_OutputValueWatches.empty())
+		RemoveOutputValueWatches(NULL, 0);
+}
+
+void Outputinfo::OnEntityCreated(CBaseEntity *pEntity, const char *classname)
+{
+	// Keyvalues (and with them the outputs) are parsed after creation.
+	MarkEntityOutputsChanged(pEntity);
+
+	// The name arrives through the KeyValue detour.
+	if(g_bNameIndexValid)
+		IndexEntityName(pEntity);
+
+	// The map's first entity is created during level init, load its rules
+	// before anything spawns.
+	if(!g_bOutputRulesLoaded)
+	{
+		LoadOutputRules();
+		g_bOutputRulesMapLoading = true;
+	}
+
+	if(g_bOutputRulesActive)
+		QueueOutputRules(pEntity);
+}
+
+void Outputinfo::OnEntityDestroyed(CBaseEntity *pEntity)
+{
+	cell_t EntityRef = gamehelpers->EntityToReference(pEntity);
+	if(g_nEntityRateLimits)
+		ClearEntityRateLimit(EntityRef);
+
+	if(!g_OutputValueWatches.empty())
+		RemoveOutputValueWatches(NULL, EntityRef);
+
+	if(g_bNameIndexValid)
+		UnindexEntityName(EntityRef);
+
+	if(!g_bTargetIndexValid)
+		return;
+
+	UnindexEntityOutputs(EntityRef);
+	g_DirtyEntities.erase(EntityRef);
 }
@@ -38,13 +38,14 @@
  */
 
 #include "smsdk_ext.h"
+#include <ISDKHooks.h>
 
 
 /**
  * @brief Sample implementation of the SDK Extension.
  * Note: Uncomment one of the pre-defined virtual functions in order to use it.
  */
-class Outputinfo : public SDKExtension
+class Outputinfo : public SDKExtension, public IHandleTypeDispatch, public ISMEntityListener, public IConCommandBaseAccessor, public IPluginsListener
 {
 public:
 	/**
@@ -81,6 +82,19 @@ public:
 	 * @return			True if working, false otherwise.
 	 */
 	//virtual bool QueryRunning(char *error, size_t maxlength);
+
+	virtual void OnCoreMapStart(edict_t *pEdictList, int edictCount, int clientMax);
+	virtual void OnCoreMapEnd();
+	virtual void NotifyInterfaceDrop(SMInterface *pInterface);
+public: // ISMEntityListener
+	virtual void OnEntityCreated(CBaseEntity *pEntity, const char *classname);
+	virtual void OnEntityDestroyed(CBaseEntity *pEntity);
+public: // IConCommandBaseAccessor
+	virtual bool RegisterConCommandBase(ConCommandBase *pCommand);
+public: // IPluginsListener
+	virtual void OnPluginUnloaded(IPlugin *plugin);
+public: // IHandleTypeDispatch
+	virtual void OnHandleDestroy(HandleType_t type, void *object);
 public:
 #if defined SMEXT_CONF_METAMOD
 	/**
@@ -91,7 +105,7 @@ public:
 	 * @param late			Whether or not Metamod considers this a late load.
 	 * @return				True to succeed, false to fail.
 	 */
-	//virtual bool SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlength, bool late);
+	virtual bool SDK_OnMetamodLoad(ISmmAPI *ismm, char *error, size_t maxlength, bool late);
 
 	/**
 	 * @brief Called when Metamod is detaching, after the extension version is called.
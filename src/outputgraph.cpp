@@ -0,0 +1,605 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * SourceMod Sample Extension
+ * Copyright (C) 2004-2008 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include "outputgraph.h"
+
+/**
+ * @file outputgraph.cpp
+ * @brief Output graph snapshot and its serializers. Nothing in here may
+ * touch game memory, it runs on worker threads.
+ */
+
+OutputGraph::OutputGraph() :
+	m_bNameIndexBuilt(false)
+{
+	// String 0 is the empty string.
+	m_Strings.push_back('\0');
+	m_StringOffsets.push_back(0);
+}
+
+uint32_t OutputGraph::Intern(const char *pString)
+{
+	if(!pString || !pString[0])
+		return 0;
+
+	auto Pointer = m_InternedPointers.find(pString);
+	if(Pointer != m_InternedPointers.end())
+		return Pointer->second;
+
+	uint32_t Id;
+	auto String = m_InternedStrings.find(pString);
+	if(String != m_InternedStrings.end())
+		Id = String->second;
+	else
+	{
+		Id = (uint32_t)m_StringOffsets.size();
+		m_StringOffsets.push_back((uint32_t)m_Strings.size());
+		m_Strings.insert(m_Strings.end(), pString, pString + strlen(pString) + 1);
+		m_InternedStrings.emplace(pString, Id);
+	}
+
+	m_InternedPointers.emplace(pString, Id);
+	return Id;
+}
+
+void OutputGraph::AddEntity(int32_t Ref, const char *pClassname, const char *pName)
+{
+	EntityRef.push_back(Ref);
+	EntityClassname.push_back(Intern(pClassname));
+	EntityName.push_back(Intern(pName));
+	EntityFirstOutput.push_back((uint32_t)OutputName.size());
+}
+
+void OutputGraph::AddOutput(const char *pName)
+{
+	OutputEntity.push_back((uint32_t)EntityRef.size() - 1);
+	OutputName.push_back(Intern(pName));
+	OutputFirstAction.push_back((uint32_t)ActionTarget.size());
+}
+
+void OutputGraph::AddAction(const char *pTarget, const char *pTargetInput, const char *pParameter, float flDelay, int32_t nTimesToFire)
+{
+	ActionTarget.push_back(Intern(pTarget));
+	ActionTargetInput.push_back(Intern(pTargetInput));
+	ActionParameter.push_back(Intern(pParameter));
+	ActionDelay.push_back(flDelay);
+	ActionTimesToFire.push_back(nTimesToFire);
+}
+
+void OutputGraph::Finish()
+{
+	EntityFirstOutput.push_back((uint32_t)OutputName.size());
+	OutputFirstAction.push_back((uint32_t)ActionTarget.size());
+
+	// Only needed while building, and pooled string pointers die with the map.
+	m_InternedPointers.clear();
+	m_InternedStrings.clear();
+}
+
+static std::string Lowercase(const char *pString)
+{
+	std::string Result(pString);
+	for(char &c : Result)
+		c = (char)tolower((unsigned char)c);
+
+	return Result;
+}
+
+void OutputGraph::BuildNameIndex() const
+{
+	for(uint32_t i = 0; i < EntityName.size(); i++)
+	{
+		if(EntityName[i])
+			m_NameIndex[Lowercase(String(EntityName[i]))].push_back(i);
+		m_ClassnameIndex[Lowercase(String(EntityClassname[i]))].push_back(i);
+	}
+
+	m_bNameIndexBuilt = true;
+}
+
+// Entities are added in index order, so exact matches already come out sorted.
+static void MatchIndex(const std::map<std::string, std::vector<uint32_t>> &Index, const std::string &Key, std::vector<uint32_t> &Entities)
+{
+	size_t Star = Key.find('*');
+	if(Star == std::string::npos)
+	{
+		auto it = Index.find(Key);
+		if(it != Index.end())
+			Entities.insert(Entities.end(), it->second.begin(), it->second.end());
+
+		return;
+	}
+
+	std::string Prefix = Key.substr(0, Star);
+	size_t First = Entities.size();
+	for(auto it = Index.lower_bound(Prefix); it != Index.end() && it->first.compare(0, Prefix.size(), Prefix) == 0; ++it)
+		Entities.insert(Entities.end(), it->second.begin(), it->second.end());
+
+	std::sort(Entities.begin() + First, Entities.end());
+}
+
+void OutputGraph::ResolveTarget(uint32_t Entity, uint32_t Action, std::vector<uint32_t> &Entities) const
+{
+	const char *pTarget = String(ActionTarget[Action]);
+	if(!pTarget[0])
+		return;
+
+	std::string Key = Lowercase(pTarget);
+	if(Key[0] == '!')
+	{
+		if(Key == "!self" || Key == "!caller")
+			Entities.push_back(Entity);
+
+		return;
+	}
+
+	if(!m_bNameIndexBuilt)
+		BuildNameIndex();
+
+	size_t First = Entities.size();
+	MatchIndex(m_NameIndex, Key, Entities);
+	if(Entities.size() == First)
+		MatchIndex(m_ClassnameIndex, Key, Entities);
+}
+
+/**
+ * Iterative Tarjan over the edges with Include[edge] set. Components are
+ * numbered in completion order, so an edge between two components always
+ * points to the lower numbered one.
+ */
+static uint32_t FindComponents(const std::vector<uint32_t> &First, const std::vector<uint32_t> &To,
+	const std::vector<uint8_t> &Include, std::vector<uint32_t> &Component)
+{
+	const uint32_t UNVISITED = UINT32_MAX;
+	uint32_t Nodes = (uint32_t)First.size() - 1;
+
+	std::vector<uint32_t> Index(Nodes, UNVISITED);
+	std::vector<uint32_t> LowLink(Nodes);
+	std::vector<uint8_t> OnStack(Nodes);
+	std::vector<uint32_t> Stack;
+	std::vector<std::pair<uint32_t, uint32_t>> CallStack; // node, next edge
+
+	Component.assign(Nodes, UNVISITED);
+	uint32_t NextIndex = 0;
+	uint32_t Count = 0;
+
+	auto Visit = [&](uint32_t Node)
+	{
+		Index[Node] = LowLink[Node] = NextIndex++;
+		Stack.push_back(Node);
+		OnStack[Node] = 1;
+		CallStack.emplace_back(Node, First[Node]);
+	};
+
+	for(uint32_t Root = 0; Root < Nodes; Root++)
+	{
+		if(Index[Root] != UNVISITED)
+			continue;
+
+		Visit(Root);
+		while(!CallStack.empty())
+		{
+			uint32_t Node = CallStack.back().first;
+			uint32_t Edge = CallStack.back().second;
+
+			if(Edge < First[Node + 1])
+			{
+				CallStack.back().second++;
+				if(!Include[Edge])
+					continue;
+
+				uint32_t Next = To[Edge];
+				if(Index[Next] == UNVISITED)
+					Visit(Next);
+				else if(OnStack[Next])
+					LowLink[Node] = std::min(LowLink[Node], Index[Next]);
+
+				continue;
+			}
+
+			CallStack.pop_back();
+			if(!CallStack.empty())
+			{
+				uint32_t Parent = CallStack.back().first;
+				LowLink[Parent] = std::min(LowLink[Parent], LowLink[Node]);
+			}
+
+			if(LowLink[Node] != Index[Node])
+				continue;
+
+			uint32_t Member;
+			do
+			{
+				Member = Stack.back();
+				Stack.pop_back();
+				OnStack[Member] = 0;
+				Component[Member] = Count;
+			} while(Member != Node);
+
+			Count++;
+		}
+	}
+
+	return Count;
+}
+
+/**
+ * Inputs that only change or remove their target and never fire one of its
+ * outputs. Edges delivering them can't close a loop or fan out any further.
+ */
+static bool InputCanFireOutputs(const char *pInput)
+{
+	static const char *s_apInert[] = {
+		"kill", "killhierarchy", "enable", "disable", "addoutput",
+		"setparent", "setparentattachment", "clearparent",
+		"alpha", "color", "enableshadow", "disableshadow", "setdamagefilter"
+	};
+
+	std::string Input = Lowercase(pInput);
+	for(const char *pInert : s_apInert)
+	{
+		if(Input == pInert)
+			return false;
+	}
+
+	return true;
+}
+
+static inline uint64_t SaturatingAdd(uint64_t a, uint64_t b)
+{
+	return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+void OutputGraph::Analyze(OutputGraphAnalysis &Analysis) const
+{
+	uint32_t Entities = (uint32_t)EntityRef.size();
+	uint32_t Outputs = (uint32_t)OutputName.size();
+	uint32_t Actions = (uint32_t)ActionTarget.size();
+
+	// Resolve every action once. Edges are stored per action, and since actions
+	// are laid out entity by entity that's also a CSR over entities.
+	std::vector<uint32_t> ActionFirstEdge(Actions + 1);
+	std::vector<uint32_t> EdgeTo;
+	std::vector<uint8_t> EdgeAll;
+	std::vector<uint8_t> EdgeZeroDelay;
+	for(uint32_t o = 0; o < Outputs; o++)
+	{
+		for(uint32_t a = OutputFirstAction[o]; a < OutputFirstAction[o + 1]; a++)
+		{
+			ActionFirstEdge[a] = (uint32_t)EdgeTo.size();
+			ResolveTarget(OutputEntity[o], a, EdgeTo);
+		}
+	}
+	ActionFirstEdge[Actions] = (uint32_t)EdgeTo.size();
+
+	// Edges whose input can't fire anything are left out of both passes.
+	std::vector<int8_t> StringFires(m_StringOffsets.size(), -1);
+	EdgeAll.resize(EdgeTo.size());
+	EdgeZeroDelay.resize(EdgeTo.size());
+	for(uint32_t a = 0; a < Actions; a++)
+	{
+		int8_t &Fires = StringFires[ActionTargetInput[a]];
+		if(Fires == -1)
+			Fires = InputCanFireOutputs(String(ActionTargetInput[a]));
+
+		for(uint32_t Edge = ActionFirstEdge[a]; Edge < ActionFirstEdge[a + 1]; Edge++)
+		{
+			EdgeAll[Edge] = Fires;
+			EdgeZeroDelay[Edge] = Fires && ActionDelay[a] <= 0.0f;
+		}
+	}
+
+	std::vector<uint32_t> EntityFirstEdge(Entities + 1);
+	for(uint32_t e = 0; e <= Entities; e++)
+		EntityFirstEdge[e] = ActionFirstEdge[OutputFirstAction[EntityFirstOutput[e]]];
+
+	// A component loops if it has more than one member or an edge to itself.
+	auto GroupComponents = [&](const std::vector<uint8_t> &Include, std::vector<uint32_t> &Component,
+		std::vector<std::vector<uint32_t>> &Members, std::vector<uint8_t> &Loops)
+	{
+		uint32_t Count = FindComponents(EntityFirstEdge, EdgeTo, Include, Component);
+		Members.assign(Count, std::vector<uint32_t>());
+		Loops.assign(Count, 0);
+
+		for(uint32_t e = 0; e < Entities; e++)
+		{
+			Members[Component[e]].push_back(e);
+			for(uint32_t Edge = EntityFirstEdge[e]; Edge < EntityFirstEdge[e + 1]; Edge++)
+			{
+				if(Include[Edge] && EdgeTo[Edge] == e)
+					Loops[Component[e]] = 1;
+			}
+		}
+
+		for(uint32_t c = 0; c < Count; c++)
+		{
+			if(Members[c].size() > 1)
+				Loops[c] = 1;
+		}
+	};
+
+	std::vector<uint32_t> Component;
+	std::vector<std::vector<uint32_t>> Members;
+	std::vector<uint8_t> Loops;
+
+	GroupComponents(EdgeZeroDelay, Component, Members, Loops);
+	Analysis.ZeroDelayCycles.clear();
+	for(uint32_t c = 0; c < Members.size(); c++)
+	{
+		if(Loops[c])
+			Analysis.ZeroDelayCycles.push_back(std::move(Members[c]));
+	}
+
+	// Fan-out over every edge, walking components from the sinks up. One input
+	// can fire several outputs (OutValue and OnHitMax, OnPressed and OnIn), so
+	// an entity's downstream cost is the sum over all of its outputs.
+	GroupComponents(EdgeAll, Component, Members, Loops);
+	std::vector<uint64_t> Downstream(Members.size());
+	std::vector<uint8_t> ReachesLoop(Members.size());
+
+	Analysis.OutputDirect.assign(Outputs, 0);
+	Analysis.OutputFanout.assign(Outputs, 0);
+	Analysis.OutputReachesLoop.assign(Outputs, false);
+
+	for(uint32_t c = 0; c < Members.size(); c++)
+	{
+		ReachesLoop[c] = Loops[c];
+		for(uint32_t e : Members[c])
+		{
+			for(uint32_t o = EntityFirstOutput[e]; o < EntityFirstOutput[e + 1]; o++)
+			{
+				uint32_t FirstEdge = ActionFirstEdge[OutputFirstAction[o]];
+				uint32_t LastEdge = ActionFirstEdge[OutputFirstAction[o + 1]];
+
+				uint64_t Fanout = 0;
+				bool bLoop = Loops[c] != 0;
+				for(uint32_t Edge = FirstEdge; Edge < LastEdge; Edge++)
+				{
+					uint32_t Target = Component[EdgeTo[Edge]];
+					Fanout = SaturatingAdd(Fanout, 1);
+
+					// Edges back into this component were already counted by going around once.
+					if(Target == c || !EdgeAll[Edge])
+						continue;
+
+					Fanout = SaturatingAdd(Fanout, Downstream[Target]);
+					bLoop = bLoop || ReachesLoop[Target];
+				}
+
+				Analysis.OutputDirect[o] = LastEdge - FirstEdge;
+				Analysis.OutputFanout[o] = Fanout;
+				Analysis.OutputReachesLoop[o] = bLoop;
+
+				Downstream[c] = SaturatingAdd(Downstream[c], Fanout);
+				ReachesLoop[c] = ReachesLoop[c] || bLoop;
+			}
+		}
+	}
+}
+
+static void WriteJsonString(FILE *pFile, const char *pString)
+{
+	fputc('"', pFile);
+	for(const unsigned char *p = (const unsigned char *)pString; *p; p++)
+	{
+		switch(*p)
+		{
+		case '"': fputs("\\\"", pFile); break;
+		case '\\': fputs("\\\\", pFile); break;
+		case '\n': fputs("\\n", pFile); break;
+		case '\r': fputs("\\r", pFile); break;
+		case '\t': fputs("\\t", pFile); break;
+		default:
+			if(*p < 0x20)
+				fprintf(pFile, "\\u%04x", *p);
+			else
+				fputc(*p, pFile);
+		}
+	}
+	fputc('"', pFile);
+}
+
+bool OutputGraph::WriteJson(FILE *pFile) const
+{
+	fputs("{\"entities\":[", pFile);
+	for(uint32_t e = 0; e < EntityRef.size(); e++)
+	{
+		fprintf(pFile, "%s\n{\"ref\":%d,\"classname\":", e ? "," : "", EntityRef[e]);
+		WriteJsonString(pFile, String(EntityClassname[e]));
+		fputs(",\"targetname\":", pFile);
+		WriteJsonString(pFile, String(EntityName[e]));
+		fputs(",\"outputs\":[", pFile);
+
+		for(uint32_t o = EntityFirstOutput[e]; o < EntityFirstOutput[e + 1]; o++)
+		{
+			fprintf(pFile, "%s{\"name\":", o != EntityFirstOutput[e] ? "," : "");
+			WriteJsonString(pFile, String(OutputName[o]));
+			fputs(",\"actions\":[", pFile);
+
+			for(uint32_t a = OutputFirstAction[o]; a < OutputFirstAction[o + 1]; a++)
+			{
+				fprintf(pFile, "%s{\"target\":", a != OutputFirstAction[o] ? "," : "");
+				WriteJsonString(pFile, String(ActionTarget[a]));
+				fputs(",\"input\":", pFile);
+				WriteJsonString(pFile, String(ActionTargetInput[a]));
+				fputs(",\"parameter\":", pFile);
+				WriteJsonString(pFile, String(ActionParameter[a]));
+				fprintf(pFile, ",\"delay\":%g,\"times\":%d}", ActionDelay[a], ActionTimesToFire[a]);
+			}
+
+			fputs("]}", pFile);
+		}
+
+		fputs("]}", pFile);
+	}
+	fputs("\n]}\n", pFile);
+
+	return !ferror(pFile);
+}
+
+static void WriteDotString(FILE *pFile, const char *pString)
+{
+	for(const char *p = pString; *p; p++)
+	{
+		if(*p == '"' || *p == '\\')
+			fputc('\\', pFile);
+		fputc(*p, pFile);
+	}
+}
+
+bool OutputGraph::WriteDot(FILE *pFile) const
+{
+	fputs("digraph outputs {\n\tnode [shape=box];\n", pFile);
+
+	// Every entity is in the snapshot for classname targets, only draw the
+	// ones with outputs or something pointing at them.
+	std::vector<uint8_t> Drawn(EntityRef.size());
+	std::vector<uint32_t> Targets;
+	for(uint32_t o = 0; o < OutputName.size(); o++)
+	{
+		Drawn[OutputEntity[o]] = 1;
+		for(uint32_t a = OutputFirstAction[o]; a < OutputFirstAction[o + 1]; a++)
+		{
+			Targets.clear();
+			ResolveTarget(OutputEntity[o], a, Targets);
+			for(uint32_t t : Targets)
+				Drawn[t] = 1;
+		}
+	}
+
+	for(uint32_t e = 0; e < EntityRef.size(); e++)
+	{
+		if(!Drawn[e])
+			continue;
+
+		fprintf(pFile, "\te%u [label=\"", e);
+		WriteDotString(pFile, EntityName[e] ? String(EntityName[e]) : "<unnamed>");
+		fputs("\\n", pFile);
+		WriteDotString(pFile, String(EntityClassname[e]));
+		fputs("\"];\n", pFile);
+	}
+
+	// Targets that resolve to nothing get one dashed node per name.
+	std::unordered_map<uint32_t, bool> Unresolved;
+	for(uint32_t o = 0; o < OutputName.size(); o++)
+	{
+		uint32_t e = OutputEntity[o];
+		for(uint32_t a = OutputFirstAction[o]; a < OutputFirstAction[o + 1]; a++)
+		{
+			Targets.clear();
+			ResolveTarget(e, a, Targets);
+
+			bool bResolved = !Targets.empty();
+			if(!bResolved)
+			{
+				if(!Unresolved[ActionTarget[a]])
+				{
+					fprintf(pFile, "\tt%u [style=dashed, label=\"", ActionTarget[a]);
+					WriteDotString(pFile, String(ActionTarget[a]));
+					fputs("\"];\n", pFile);
+					Unresolved[ActionTarget[a]] = true;
+				}
+				Targets.push_back(ActionTarget[a]);
+			}
+
+			for(uint32_t t : Targets)
+			{
+				fprintf(pFile, "\te%u -> %c%u [label=\"", e, bResolved ? 'e' : 't', t);
+				WriteDotString(pFile, String(OutputName[o]));
+				fputs(" > ", pFile);
+				WriteDotString(pFile, String(ActionTargetInput[a]));
+				if(ActionParameter[a])
+				{
+					fputs("(", pFile);
+					WriteDotString(pFile, String(ActionParameter[a]));
+					fputs(")", pFile);
+				}
+				if(ActionDelay[a] > 0.0f)
+					fprintf(pFile, " %gs", ActionDelay[a]);
+				fputs("\"];\n", pFile);
+			}
+		}
+	}
+
+	fputs("}\n", pFile);
+	return !ferror(pFile);
+}
+
+template <typename T>
+static void WriteArray(FILE *pFile, const std::vector<T> &Array)
+{
+	if(!Array.empty())
+		fwrite(Array.data(), sizeof(T), Array.size(), pFile);
+}
+
+/**
+ * Binary layout, host byte order:
+ *   char magic[4] "OIG1"
+ *   uint32 strings, string bytes, entities, outputs, actions
+ *   char string data[string bytes], uint32 string offsets[strings]
+ *   int32 entity ref[entities], uint32 classname[entities], name[entities], first output[entities + 1]
+ *   uint32 output entity[outputs], name[outputs], first action[outputs + 1]
+ *   uint32 target[actions], input[actions], parameter[actions]
+ *   float delay[actions], int32 times to fire[actions]
+ */
+bool OutputGraph::WriteBinary(FILE *pFile) const
+{
+	uint32_t aHeader[5] = {
+		(uint32_t)m_StringOffsets.size(),
+		(uint32_t)m_Strings.size(),
+		(uint32_t)EntityRef.size(),
+		(uint32_t)OutputName.size(),
+		(uint32_t)ActionTarget.size()
+	};
+
+	fwrite("OIG1", 1, 4, pFile);
+	fwrite(aHeader, sizeof(aHeader), 1, pFile);
+
+	WriteArray(pFile, m_Strings);
+	WriteArray(pFile, m_StringOffsets);
+	WriteArray(pFile, EntityRef);
+	WriteArray(pFile, EntityClassname);
+	WriteArray(pFile, EntityName);
+	WriteArray(pFile, EntityFirstOutput);
+	WriteArray(pFile, OutputEntity);
+	WriteArray(pFile, OutputName);
+	WriteArray(pFile, OutputFirstAction);
+	WriteArray(pFile, ActionTarget);
+	WriteArray(pFile, ActionTargetInput);
+	WriteArray(pFile, ActionParameter);
+	WriteArray(pFile, ActionDelay);
+	WriteArray(pFile, ActionTimesToFire);
+
+	return !ferror(pFile);
+}
@@ -0,0 +1,143 @@
+/**
+ * vim: set ts=4 :
+ * =============================================================================
+ * SourceMod Sample Extension
+ * Copyright (C) 2004-2008 AlliedModders LLC.  All rights reserved.
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2," the
+ * "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+ * by the Valve Corporation.  You must obey the GNU General Public License in
+ * all respects for all other code used.  Additionally, AlliedModders LLC grants
+ * this exception to all derivative works.  AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>.
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_OUTPUTGRAPH_H_
+#define _INCLUDE_SOURCEMOD_OUTPUTGRAPH_H_
+
+/**
+ * @file outputgraph.h
+ * @brief Flat snapshot of every entity's outputs and actions.
+ *
+ * The snapshot is built on the game thread in one linear pass and owns all
+ * of its data (strings are interned into one buffer), so it can be handed to
+ * a worker thread without touching game memory again.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Result of OutputGraph::Analyze.
+ *
+ * Which input of an entity fires which of its outputs isn't known statically,
+ * so any input delivered to an entity is assumed to fire every one of its
+ * outputs, except for a few like Kill or AddOutput that never fire any. That
+ * makes the numbers an upper bound.
+ */
+struct OutputGraphAnalysis
+{
+	// Entities of every strongly connected component whose loop has no delay
+	// anywhere, which the event queue will spin on within a single frame.
+	std::vector<std::vector<uint32_t>> ZeroDelayCycles;
+
+	// Per output: inputs its actions deliver directly, worst case inputs
+	// delivered by one fire following the whole chain (loops counted once),
+	// and whether the chain runs into a loop.
+	std::vector<uint32_t> OutputDirect;
+	std::vector<uint64_t> OutputFanout;
+	std::vector<bool> OutputReachesLoop;
+};
+
+class OutputGraph
+{
+public:
+	OutputGraph();
+
+	/**
+	 * @brief Building, in order: an entity, then its outputs, each followed by its actions.
+	 */
+	void AddEntity(int32_t Ref, const char *pClassname, const char *pName);
+	void AddOutput(const char *pName);
+	void AddAction(const char *pTarget, const char *pTargetInput, const char *pParameter, float flDelay, int32_t nTimesToFire);
+	void Finish();
+
+	const char *String(uint32_t Id) const { return &m_Strings[m_StringOffsets[Id]]; }
+
+	size_t EntityCount() const { return EntityRef.size(); }
+	size_t OutputCount() const { return OutputName.size(); }
+	size_t ActionCount() const { return ActionTarget.size(); }
+
+	/**
+	 * @brief Appends the entities an action's target name resolves to, using
+	 * the engine's rules: case-insensitive, anything from the first '*' on
+	 * matches any suffix, and classnames are tried when no targetname
+	 * matches. !self and !caller are the entity owning the output, other
+	 * !specials depend on who fires the output and resolve to nothing.
+	 */
+	void ResolveTarget(uint32_t Entity, uint32_t Action, std::vector<uint32_t> &Entities) const;
+
+	void Analyze(OutputGraphAnalysis &Analysis) const;
+
+	bool WriteJson(FILE *pFile) const;
+	bool WriteDot(FILE *pFile) const;
+	bool WriteBinary(FILE *pFile) const;
+
+public:
+	// Struct of arrays, outputs of entity i are [EntityFirstOutput[i], EntityFirstOutput[i + 1])
+	// and actions of output j are [OutputFirstAction[j], OutputFirstAction[j + 1]).
+	std::vector<int32_t> EntityRef;
+	std::vector<uint32_t> EntityClassname;
+	std::vector<uint32_t> EntityName;
+	std::vector<uint32_t> EntityFirstOutput;
+
+	std::vector<uint32_t> OutputEntity;
+	std::vector<uint32_t> OutputName;
+	std::vector<uint32_t> OutputFirstAction;
+
+	std::vector<uint32_t> ActionTarget;
+	std::vector<uint32_t> ActionTargetInput;
+	std::vector<uint32_t> ActionParameter;
+	std::vector<float> ActionDelay;
+	std::vector<int32_t> ActionTimesToFire;
+
+private:
+	uint32_t Intern(const char *pString);
+	void BuildNameIndex() const;
+
+	std::vector<char> m_Strings;
+	std::vector<uint32_t> m_StringOffsets;
+
+	// Pooled game strings repeat by pointer, so that's checked before hashing the contents.
+	std::unordered_map<const char *, uint32_t> m_InternedPointers;
+	std::unordered_map<std::string, uint32_t> m_InternedStrings;
+
+	// Lowercased targetname and classname -> entities, sorted for prefix
+	// lookups and built on first ResolveTarget.
+	mutable std::map<std::string, std::vector<uint32_t>> m_NameIndex;
+	mutable std::map<std::string, std::vector<uint32_t>> m_ClassnameIndex;
+	mutable bool m_bNameIndexBuilt;
+};
+
+#endif // _INCLUDE_SOURCEMOD_OUTPUTGRAPH_H_